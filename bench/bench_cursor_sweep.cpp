@@ -0,0 +1,86 @@
+// Cursor sweep benchmark: value-at-time lookups for every signal as the
+// cursor moves across the trace, the work drawSignalValues does per move.
+//
+// Usage: bench_cursor_sweep [signals] [changes_per_signal] [steps]
+// Defaults to 1000 signals x 100k changes (~0.8 GB); the full 1000 x 1M
+// sweep needs ~8 GB (pass 1000 1000000). Compares a linear scan, a plain
+// binary search and the hinted search the viewer uses.
+
+#include "waveform_data.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    size_t numSignals = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t perSignal = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    size_t steps = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10000;
+
+    std::vector<SignalChanges> signals(numSignals);
+    u64 endTime = 0;
+    for (size_t s = 0; s < numSignals; ++s) {
+        auto& changes = signals[s];
+        changes.reserve(perSignal);
+        u64 period = 2 + s % 7;
+        for (size_t i = 0; i < perSignal; ++i) changes.push_back({i * period, i & 1});
+        endTime = std::max(endTime, changes.back().time);
+    }
+    std::printf("%zu signals x %zu changes, %zu cursor steps\n", numSignals, perSignal, steps);
+
+    using Clock = std::chrono::steady_clock;
+    auto report = [&](const char* label, Clock::time_point t0, size_t lookups, u64 sum) {
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+        std::printf("%-8s %10.1f ns/lookup %10.3f ms/step  (checksum %llu)\n", label,
+                    ns / double(lookups), ns / 1e6 / double(steps),
+                    static_cast<unsigned long long>(sum));
+    };
+    auto cursorAt = [&](size_t step) { return endTime * step / steps; };
+
+    // The linear scan is quadratic over a sweep; time a few steps only
+    size_t linearSteps = std::min<size_t>(steps, 20);
+    u64 sum = 0;
+    auto t0 = Clock::now();
+    for (size_t step = 0; step < linearSteps; ++step) {
+        u64 t = cursorAt(step * steps / linearSteps);
+        for (const auto& changes : signals) {
+            size_t i = 0;
+            while (i < changes.size() && changes.time(i) <= t) ++i;
+            sum += changes.value(i ? i - 1 : 0);
+        }
+    }
+    {
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+        std::printf("%-8s %10.1f ns/lookup %10.3f ms/step  (checksum %llu)\n", "linear",
+                    ns / double(linearSteps * numSignals), ns / 1e6 / double(linearSteps),
+                    static_cast<unsigned long long>(sum));
+    }
+
+    sum = 0;
+    t0 = Clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+        u64 t = cursorAt(step);
+        for (const auto& changes : signals) {
+            size_t i = changes.upperBound(t);
+            sum += changes.value(i ? i - 1 : 0);
+        }
+    }
+    report("binary", t0, steps * numSignals, sum);
+
+    std::vector<size_t> hints(numSignals, 0);
+    sum = 0;
+    t0 = Clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+        u64 t = cursorAt(step);
+        for (size_t s = 0; s < numSignals; ++s) {
+            size_t i = signals[s].upperBound(t, hints[s]);
+            hints[s] = i;
+            sum += signals[s].value(i ? i - 1 : 0);
+        }
+    }
+    report("hinted", t0, steps * numSignals, sum);
+    return 0;
+}
@@ -0,0 +1,79 @@
+// DrawPass batching on a recorded viewer frame.
+//
+// Usage: bench_draw_pass [file.vcd]
+// Records one 1920x1080 frame of the given dump (or of generated clocks and
+// buses), then replays it onto a raster surface in recorded and in DrawPass
+// order. Prints the flushes and state switches a batching backend would see
+// for each order, plus the replay and sort times.
+
+#include "waveform_viewer.hpp"
+#include "vcd_parser.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    VcdParser parser;
+    WaveformData generated;
+    WaveformData* data = &generated;
+    if (argc > 1) {
+        if (!parser.parse(argv[1])) {
+            std::fprintf(stderr, "cannot parse %s\n", argv[1]);
+            return 1;
+        }
+        data = &parser.data();
+    } else {
+        generated.endTime = 100000;
+        for (int i = 0; i < 32; ++i) {
+            bool bus = i % 2;
+            Signal sig{"sig" + std::to_string(i), "x", bus ? 16 : 1, {}};
+            for (u64 t = 0, n = 0; t < generated.endTime; t += 20 + i * 3, ++n) {
+                sig.changes.push_back({t, bus ? (n * 2654435761u) & 0xFFFF : n & 1});
+            }
+            sig.lod.build(sig.changes);
+            generated.signals.push_back(std::move(sig));
+        }
+    }
+
+    constexpr i32 kWidth = 1920, kHeight = 1080;
+    WaveformViewer viewer;
+    viewer.setSize(kWidth, kHeight);
+    viewer.setData(data);
+    viewer.setView(0, f64(kWidth - 120) / std::max<u64>(1, data->endTime / 20));
+    viewer.setCursorTime(f64(data->endTime) / 40);
+    auto recorder = Surface::MakeRecording(kWidth, kHeight);
+    recorder->beginFrame();
+    viewer.paint(recorder.get());
+    recorder->endFrame();
+    auto frame = recorder->takeRecording();
+    const WaveformViewer::CulledOps& culled = viewer.culledOps();
+    std::printf("%zu ops, culled at record time: static %llu, waveform %llu, overlay %llu\n",
+                frame->ops().size(), static_cast<unsigned long long>(culled.staticLayer),
+                static_cast<unsigned long long>(culled.waveformLayer),
+                static_cast<unsigned long long>(culled.overlayLayer));
+
+    constexpr int kRuns = 50;
+    for (bool sort : {false, true}) {
+        auto target = Surface::MakeRaster(kWidth, kHeight);
+        target->setDrawPass(sort, 0);
+        target->setCollectSubmitStats(true);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < kRuns; ++r) target->submit(*frame);
+        auto t1 = std::chrono::steady_clock::now();
+        const SubmitStats& stats = target->submitStats();
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / kRuns;
+        std::printf("%-8s flushes %6llu  state switches %6llu  %8.1f us/replay\n",
+                    sort ? "sorted" : "recorded",
+                    static_cast<unsigned long long>(stats.submitted.flushes / kRuns),
+                    static_cast<unsigned long long>(stats.submitted.stateSwitches / kRuns), us);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < kRuns; ++r) DrawPass::create(*frame);
+    auto t1 = std::chrono::steady_clock::now();
+    std::printf("DrawPass::create %8.1f us\n",
+                std::chrono::duration<double, std::micro>(t1 - t0).count() / kRuns);
+    return 0;
+}
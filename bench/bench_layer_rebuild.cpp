@@ -0,0 +1,58 @@
+// Waveform layer rebuild time versus recording threads.
+//
+// Usage: bench_layer_rebuild [max_threads] [rows]
+// Fills a tall window with bus rows (default 64) zoomed in far enough that
+// every row records polylines and value labels, then times full layer
+// rebuilds (every row stale) with 1, 2, 4, ... recording threads.
+
+#include "waveform_viewer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    i32 maxThreads = argc > 1 ? std::atoi(argv[1])
+                              : i32(std::max(1u, std::thread::hardware_concurrency()));
+    i32 rows = argc > 2 ? std::atoi(argv[2]) : 64;
+
+    WaveformData data;
+    data.timescale = 1;
+    data.endTime = 1000000;
+    for (i32 r = 0; r < rows; ++r) {
+        Signal sig{"bus" + std::to_string(r), "x", 32, {}};
+        for (u64 t = 0; t < data.endTime; t += 7 + r % 5) sig.changes.push_back({t, t * 2654435761u + r});
+        sig.lod.build(sig.changes);
+        data.signals.push_back(std::move(sig));
+    }
+
+    const i32 width = 1920, height = 30 + rows * 35;
+    constexpr int kFrames = 40;
+    std::printf("%d rows, %dx%d, %d rebuilds per setting\n", rows, width, height, kFrames);
+
+    double base = 0;
+    for (i32 threads = 1; threads <= maxThreads; threads *= 2) {
+        WaveformViewer viewer;
+        viewer.setSize(width, height);
+        viewer.setData(&data);
+        viewer.setRecordThreads(threads);
+        auto target = Surface::MakeRecording(width, height);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int f = 0; f < kFrames; ++f) {
+            // ~3 changes per 40 px: the raw path with labels on every segment
+            viewer.setView(1000 + f * 100, 0.15);
+            target->beginFrame();
+            viewer.paint(target.get());
+            target->endFrame();
+            target->takeRecording();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / kFrames;
+        if (threads == 1) base = ms;
+        std::printf("threads %2d  %8.2f ms/rebuild  speedup %.2fx\n", threads, ms, base / ms);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// Raster frame cost while dragging the view sideways.
+//
+// Usage: bench_raster_pan [pixels_per_frame]
+// Fills an 800x600 raster view with clocks and buses, then pans it a few
+// pixels per frame (default 4) with and without scroll reuse. With reuse
+// the rasterized area per frame should track the exposed strip width.
+
+#include "waveform_viewer.hpp"
+#include "glyph_cache.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    i32 step = argc > 1 ? std::atoi(argv[1]) : 4;
+    constexpr u64 kEnd = 2000000;
+
+    WaveformData data;
+    data.timescale = 1;
+    data.endTime = kEnd;
+    for (int i = 0; i < 16; ++i) {
+        bool bus = i % 2;
+        Signal sig{"top.sig" + std::to_string(i), std::to_string(i), bus ? 32 : 1, {}};
+        u64 period = 10 + u64(i) * 7;
+        for (u64 t = 0, n = 0; t < kEnd; t += period, ++n) {
+            sig.changes.push_back({t, bus ? (n * 2654435761u) & 0xFFFFFFFF : n & 1});
+        }
+        sig.lod.build(sig.changes);
+        data.signals.push_back(std::move(sig));
+    }
+
+    GlyphCache glyphs;
+    bool font = glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f);
+
+    constexpr i32 kWidth = 800, kHeight = 600;
+    constexpr int kFrames = 200;
+    std::printf("%d px per frame, %d frames%s\n", step, kFrames, font ? "" : " (no font, text skipped)");
+    for (bool reuse : {false, true}) {
+        WaveformViewer viewer;
+        viewer.setSize(kWidth, kHeight);
+        viewer.setData(&data);
+        viewer.setScrollReuse(reuse);
+        auto target = Surface::MakeRaster(kWidth, kHeight);
+        if (font) target->setGlyphCache(&glyphs);
+
+        const f64 scale = 0.5;
+        viewer.setView(100000, scale);
+        target->beginFrame();
+        viewer.paint(target.get());
+
+        u64 pixels = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int f = 1; f <= kFrames; ++f) {
+            viewer.setView(100000 - f * step / scale, scale);
+            target->beginFrame();
+            viewer.paint(target.get());
+            pixels += viewer.pixelsRedrawn();
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / kFrames;
+        std::printf("%-8s %9.1f us/frame  %8llu px rasterized/frame\n", reuse ? "reuse" : "full", us,
+                    static_cast<unsigned long long>(reuse ? pixels / kFrames : u64(kWidth) * kHeight));
+    }
+    return 0;
+}
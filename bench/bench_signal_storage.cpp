@@ -0,0 +1,70 @@
+// Signal change storage benchmark: flat time column vs delta-compressed blocks.
+//
+// Usage: bench_signal_storage [changes_millions]
+// Builds one scalar and one 32-bit bus signal with random small time deltas
+// (default 20M changes each) and reports bytes per change, sequential scan
+// speed and random getValueAtTime-style lookups for both layouts.
+
+#include "waveform_data.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace wv;
+
+static SignalChanges makeSignal(size_t count, bool bus) {
+    u64 state = 0x9E3779B97F4A7C15ull;
+    SignalChanges changes;
+    changes.reserve(count);
+    u64 t = 0;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        t += 1 + state % 200;
+        changes.push_back({t, bus ? u32(state >> 32) : (i & 1)});
+    }
+    changes.shrink_to_fit();
+    return changes;
+}
+
+static void bench(const char* label, const SignalChanges& changes) {
+    using Clock = std::chrono::steady_clock;
+    const size_t n = changes.size();
+
+    u64 sum = 0;
+    auto t0 = Clock::now();
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        sum += it.time() ^ it.value();
+    }
+    auto t1 = Clock::now();
+
+    constexpr size_t kLookups = 2000000;
+    const u64 endTime = changes.back().time;
+    u64 state = 12345;
+    for (size_t i = 0; i < kLookups; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        size_t idx = changes.upperBound((state >> 11) % endTime);
+        sum += changes.value(idx ? idx - 1 : 0);
+    }
+    auto t2 = Clock::now();
+
+    double scanNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / double(n);
+    double lookupNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / kLookups;
+    std::printf("%-18s %6.2f B/change  scan %5.2f ns/change  lookup %6.1f ns  (checksum %llu)\n",
+                label, double(changes.memoryBytes()) / double(n), scanNs, lookupNs,
+                static_cast<unsigned long long>(sum));
+}
+
+int main(int argc, char* argv[]) {
+    size_t millions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    size_t count = millions * 1000000;
+
+    for (bool bus : {false, true}) {
+        SignalChanges changes = makeSignal(count, bus);
+        bench(bus ? "bus flat" : "scalar flat", changes);
+        changes.compress();
+        bench(bus ? "bus compressed" : "scalar compressed", changes);
+    }
+    return 0;
+}
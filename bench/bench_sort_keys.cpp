@@ -0,0 +1,61 @@
+// DrawPass key sort: LSD radix sort versus std::stable_sort.
+//
+// Usage: bench_sort_keys
+// Sorts batch keys shaped like a dense bus recording (ops joining one of the
+// last few batches) at 1k, 10k and 1M ops. The radix sort reuses its scratch
+// buffer across runs, as Surface does across frames.
+
+#include "draw_pass.hpp"
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+using namespace wv;
+
+static std::vector<SortKey> makeKeys(size_t count) {
+    std::mt19937 rng(7);
+    std::vector<SortKey> keys;
+    keys.reserve(count);
+    // Ops mostly join one of the last few batches; a new one opens every
+    // 16 ops or so
+    u64 open = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (rng() % 16 == 0) open++;
+        u64 back = rng() % 4;
+        keys.push_back({open - std::min(open, back), u32(i)});
+    }
+    return keys;
+}
+
+int main() {
+    for (size_t count : {size_t(1000), size_t(10000), size_t(1000000)}) {
+        const std::vector<SortKey> input = makeKeys(count);
+        int runs = count >= 1000000 ? 10 : 200;
+
+        std::vector<SortKey> keys;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r) {
+            keys = input;
+            std::stable_sort(keys.begin(), keys.end());
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<SortKey> expected = keys;
+
+        std::vector<SortKey> tmp;
+        auto t2 = std::chrono::steady_clock::now();
+        for (int r = 0; r < runs; ++r) {
+            keys = input;
+            DrawPass::sortKeys(keys, tmp);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+
+        bool same = true;
+        for (size_t i = 0; i < count; ++i) same = same && keys[i].opIndex == expected[i].opIndex;
+        double stable = std::chrono::duration<double, std::micro>(t1 - t0).count() / runs;
+        double radix = std::chrono::duration<double, std::micro>(t3 - t2).count() / runs;
+        std::printf("%8zu keys  stable_sort %10.1f us  radix %10.1f us  %5.2fx%s\n",
+                    count, stable, radix, stable / radix, same ? "" : "  MISMATCH");
+    }
+    return 0;
+}
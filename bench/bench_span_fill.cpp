@@ -0,0 +1,67 @@
+// Fill rate of the raster span kernels, in Mpix/s.
+//
+// Usage: bench_span_fill
+// Times each kernel set on a 1920x1080 buffer with full-width rows and with
+// 16-pixel spans (typical of waveform segments), then the raster device's
+// fillRect, which uses the kernels picked for this CPU.
+
+#include "span_kernels.hpp"
+#include "surface.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace wv;
+
+constexpr i32 kWidth = 1920, kHeight = 1080;
+
+template <typename Fn>
+static double mpixPerSecond(u64 pixels, Fn fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    auto t1 = std::chrono::steady_clock::now();
+    return double(pixels) / std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+int main() {
+    std::vector<u32> buffer(size_t(kWidth) * kHeight, 0xFF203040);
+    constexpr int kRuns = 20;
+    const u64 frame = u64(kWidth) * kHeight * kRuns;
+
+    std::printf("%-7s %12s %12s %12s %12s %12s\n", "isa", "fill", "blend", "fill16", "blend16", "swizzle");
+    for (SpanIsa isa : {SpanIsa::Scalar, SpanIsa::SSE2, SpanIsa::AVX2}) {
+        const SpanKernels& k = SpanKernels::ForIsa(isa);
+        if (&k != &SpanKernels::ForIsa(SpanIsa::Scalar) && isa == SpanIsa::Scalar) continue;
+        if (isa != SpanIsa::Scalar && &k == &SpanKernels::ForIsa(SpanIsa(int(isa) - 1))) continue;
+        auto rows = [&](i32 span, auto op) {
+            return mpixPerSecond(frame, [&]() {
+                for (int r = 0; r < kRuns; ++r) {
+                    for (i32 y = 0; y < kHeight; ++y) {
+                        u32* row = buffer.data() + size_t(y) * kWidth;
+                        for (i32 x = 0; x < kWidth; x += span) op(row + x, span);
+                    }
+                }
+            });
+        };
+        double fill = rows(kWidth, [&](u32* p, i32 n) { k.fill(p, n, 0xFF112233); });
+        double blend = rows(kWidth, [&](u32* p, i32 n) { k.blend(p, n, 0xFF80C0E0, 96); });
+        double fill16 = rows(16, [&](u32* p, i32 n) { k.fill(p, n, 0xFF112233); });
+        double blend16 = rows(16, [&](u32* p, i32 n) { k.blend(p, n, 0xFF80C0E0, 96); });
+        double swizzle = rows(kWidth, [&](u32* p, i32 n) { k.swizzle(p, p, n); });
+        std::printf("%-7s %12.0f %12.0f %12.0f %12.0f %12.0f\n", SpanKernels::IsaName(isa),
+                    fill, blend, fill16, blend16, swizzle);
+    }
+
+    auto surface = Surface::MakeRaster(kWidth, kHeight);
+    Canvas* canvas = surface->canvas();
+    for (u8 alpha : {u8(255), u8(96)}) {
+        double rate = mpixPerSecond(frame, [&]() {
+            for (int r = 0; r < kRuns; ++r) {
+                canvas->fillRect({0, 0, f32(kWidth), f32(kHeight)}, {128, 192, 224, alpha});
+            }
+        });
+        std::printf("device fillRect alpha %3d: %8.0f Mpix/s (%s)\n", alpha, rate,
+                    SpanKernels::IsaName(SpanKernels::BestIsa()));
+    }
+    return 0;
+}
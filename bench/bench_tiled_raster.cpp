@@ -0,0 +1,87 @@
+// Raster replay frame rate versus tiled raster threads.
+//
+// Usage: bench_tiled_raster [max_threads] [font.ttf]
+// Records one viewer frame of generated clocks and buses at 1920x1080 and at
+// 3840x2160, then replays it onto a raster surface (clear plus replay, as a
+// frame) untiled, then in 512x64 tiles on 1, 2, 4, ... threads.
+// Text is drawn when the font loads (default DejaVu Sans Mono).
+
+#include "waveform_viewer.hpp"
+#include "glyph_cache.hpp"
+#include "raster_device.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    i32 maxThreads = argc > 1 ? std::atoi(argv[1])
+                              : i32(std::max(1u, std::thread::hardware_concurrency()));
+    const char* font = argc > 2 ? argv[2] : "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf";
+    GlyphCache glyphs;
+    bool text = glyphs.init(font, 13.0f);
+    if (!text) std::printf("cannot load %s, replaying without text\n", font);
+
+    WaveformData data;
+    data.timescale = 1;
+    data.endTime = 1000000;
+    for (i32 r = 0; r < 128; ++r) {
+        bool bus = r % 2;
+        Signal sig{"sig" + std::to_string(r), "x", bus ? 16 : 1, {}};
+        for (u64 t = 0, n = 0; t < data.endTime; t += 20 + r * 3, ++n) {
+            sig.changes.push_back({t, bus ? (n * 2654435761u) & 0xFFFF : n & 1});
+        }
+        sig.lod.build(sig.changes);
+        data.signals.push_back(std::move(sig));
+    }
+
+    for (auto [width, height] : {std::pair<i32, i32>{1920, 1080}, {3840, 2160}}) {
+        WaveformViewer viewer;
+        viewer.setSize(width, height);
+        viewer.setData(&data);
+        viewer.setView(0, 0.5);
+        viewer.setCursorTime(5000);
+        auto recorder = Surface::MakeRecording(width, height);
+        recorder->beginFrame();
+        viewer.paint(recorder.get());
+        recorder->endFrame();
+        auto frame = recorder->takeRecording();
+        std::printf("%dx%d, %zu ops\n", width, height, frame->ops().size());
+
+        constexpr int kFrames = 30;
+        auto time = [&](const char* label, i32 threads, auto&& paint) {
+            paint();
+            auto t0 = std::chrono::steady_clock::now();
+            for (int f = 0; f < kFrames; ++f) paint();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / kFrames;
+            std::printf("  %-8s %2d  %8.2f ms/frame  %7.1f fps\n", label, threads, ms, 1000 / ms);
+        };
+
+        auto target = Surface::MakeRaster(width, height);
+        if (text) target->setGlyphCache(&glyphs);
+        auto paint = [&]() {
+            target->beginFrame();
+            target->submit(*frame);
+            target->endFrame();
+        };
+        time("untiled", 1, paint);
+
+        // Tiling overhead alone: the tiled replay on the calling thread
+        SoftwareRasterDevice device(target->peekPixels());
+        if (text) device.setGlyphCache(&glyphs);
+        TiledRaster single(1);
+        time("tiled", 1, [&]() {
+            device.beginFrame();
+            single.replay(*frame, nullptr, device);
+        });
+
+        for (i32 threads = 2; threads <= maxThreads; threads *= 2) {
+            target->setRasterThreads(threads);
+            time("tiled", threads, paint);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+// VCD parse throughput benchmark.
+//
+// Usage: bench_vcd_parse [size_mb] [path] [max_threads]
+// Generates a synthetic dump of roughly size_mb megabytes (default 64) and
+// reports MB/s for each parse mode and for the chunked parallel parser, plus
+// the per-change identifier lookup cost (hash map vs VcdIdTable).
+
+#include "vcd_parser.hpp"
+#include "waveform_cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace wv;
+
+static std::string idFor(int index) {
+    std::string id;
+    do {
+        id += char(33 + index % 94);
+        index /= 94;
+    } while (index > 0);
+    return id;
+}
+
+static size_t writeSyntheticVcd(const std::string& path, size_t targetBytes) {
+    constexpr int kScalars = 192;
+    constexpr int kBuses = 64;
+
+    std::ofstream f(path, std::ios::binary);
+    f << "$timescale 1ps $end\n$scope module top $end\n";
+    for (int i = 0; i < kScalars; ++i)
+        f << "$var wire 1 " << idFor(i) << " s" << i << " $end\n";
+    for (int i = 0; i < kBuses; ++i)
+        f << "$var wire 32 " << idFor(kScalars + i) << " bus" << i << " [31:0] $end\n";
+    f << "$upscope $end\n$enddefinitions $end\n";
+
+    u64 state = 0x9E3779B97F4A7C15ull;
+    auto rnd = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+
+    std::string line;
+    for (u64 t = 0; size_t(f.tellp()) < targetBytes; t += 10) {
+        f << '#' << t << '\n';
+        for (int i = 0; i < 24; ++i) {
+            int s = int(rnd() % kScalars);
+            f << char('0' + (rnd() & 1)) << idFor(s) << '\n';
+        }
+        for (int i = 0; i < 4; ++i) {
+            int b = int(rnd() % kBuses);
+            u32 v = u32(rnd());
+            line.assign("b");
+            for (int bit = 31; bit >= 0; --bit) line += ((v >> bit) & 1) ? '1' : '0';
+            f << line << ' ' << idFor(kScalars + b) << '\n';
+        }
+    }
+    return size_t(f.tellp());
+}
+
+// Parses the text every time, without the .wvc cache
+static ParseOptions textParse(i32 threads, ParseMode mode = ParseMode::Mapped) {
+    ParseOptions options;
+    options.threads = threads;
+    options.mode = mode;
+    options.cache = false;
+    return options;
+}
+
+static double timeParse(const std::string& path, const ParseOptions& options, int reps) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        VcdParser parser;
+        auto t0 = std::chrono::steady_clock::now();
+        parser.parse(path, options);
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+// 50k identifiers (up to 3 characters) looked up in a pseudo-random order
+static void benchIdLookup() {
+    constexpr int kSignals = 50000;
+    constexpr int kLookups = 20000000;
+
+    std::vector<Signal> signals;
+    signals.reserve(kSignals);
+    for (int i = 0; i < kSignals; ++i) signals.push_back({"s", idFor(i), 1, {}});
+
+    std::unordered_map<std::string, size_t> hashed;
+    for (int i = 0; i < kSignals; ++i) hashed[signals[i].id] = size_t(i);
+    VcdIdTable table;
+    table.build(signals);
+
+    std::vector<std::string_view> queries;
+    for (int i = 0; i < 4096; ++i) queries.push_back(signals[(i * 7919) % kSignals].id);
+
+    size_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLookups; ++i) {
+        sum += hashed.find(std::string(queries[i & 4095]))->second;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLookups; ++i) {
+        sum += table.find(queries[i & 4095]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double hashNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / kLookups;
+    double tableNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / kLookups;
+    std::printf("id lookup: hash map %.1f ns, id table %.1f ns (checksum %zu)\n",
+                hashNs, tableNs, sum);
+}
+
+int main(int argc, char* argv[]) {
+    size_t sizeMb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    std::string path = argc > 2 ? argv[2] : "/tmp/wv_bench_parse.vcd";
+
+    size_t bytes = writeSyntheticVcd(path, sizeMb << 20);
+    double mb = double(bytes) / (1 << 20);
+    std::printf("input: %s (%.1f MB)\n", path.c_str(), mb);
+
+    double stream = timeParse(path, textParse(1, ParseMode::Stream), 3);
+    double mapped = timeParse(path, textParse(1), 3);
+    std::printf("%-12s %8.3f s %10.1f MB/s\n", "stream", stream, mb / stream);
+    std::printf("%-12s %8.3f s %10.1f MB/s\n", "mapped", mapped, mb / mapped);
+
+    i32 maxThreads = argc > 3 ? std::atoi(argv[3])
+                              : i32(std::max(1u, std::thread::hardware_concurrency()));
+    for (i32 threads = 2; threads <= maxThreads; threads *= 2) {
+        double t = timeParse(path, textParse(threads), 3);
+        char label[32];
+        std::snprintf(label, sizeof(label), "mapped x%d", threads);
+        std::printf("%-12s %8.3f s %10.1f MB/s\n", label, t, mb / t);
+    }
+
+    ParseOptions cached;
+    std::remove(WaveformCache::PathFor(path).c_str());
+    double write = timeParse(path, cached, 1);
+    double reopen = timeParse(path, cached, 3);
+    cached.lazy = true;
+    double reopenLazy = timeParse(path, cached, 3);
+    std::printf("%-12s %8.3f s (parse + write .wvc)\n", "cache write", write);
+    std::printf("%-12s %8.3f s\n", "cache open", reopen);
+    std::printf("%-12s %8.3f s\n", "cache lazy", reopenLazy);
+
+    benchIdLookup();
+    return 0;
+}
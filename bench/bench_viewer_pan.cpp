@@ -0,0 +1,63 @@
+// Waveform layer cost while panning a long trace.
+//
+// Usage: bench_viewer_pan [changes_millions]
+// Builds a clock and a 16-bit bus with a few million changes each (default
+// 10M on the clock), zooms in so roughly 1000 clock edges are visible and
+// times repainting the view at several pan positions. With culling the
+// per-frame cost should be flat across positions.
+
+#include "waveform_viewer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace wv;
+
+int main(int argc, char* argv[]) {
+    size_t millions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10;
+    const u64 count = u64(millions) * 1000000;
+    constexpr u64 kPeriod = 10;
+
+    WaveformData data;
+    data.timescale = 1;
+    data.endTime = count * kPeriod;
+    Signal clk{"clk", "!", 1, {}};
+    Signal bus{"bus", "\"", 16, {}};
+    clk.changes.reserve(count);
+    for (u64 i = 0; i < count; ++i) {
+        clk.changes.push_back({i * kPeriod, i & 1});
+        if (i % 4 == 0) bus.changes.push_back({i * kPeriod, (i * 2654435761u) & 0xFFFF});
+    }
+    clk.lod.build(clk.changes);
+    bus.lod.build(bus.changes);
+    data.signals.push_back(std::move(clk));
+    data.signals.push_back(std::move(bus));
+
+    constexpr i32 kWidth = 1200, kHeight = 200;
+    WaveformViewer viewer;
+    viewer.setSize(kWidth, kHeight);
+    viewer.setData(&data);
+    auto target = Surface::MakeRecording(kWidth, kHeight);
+
+    const f64 scale = f64(kWidth - 120) / (1000 * kPeriod);
+    constexpr int kFrames = 50;
+    std::printf("%llu changes, %d frames per position\n",
+                static_cast<unsigned long long>(count), kFrames);
+    for (f64 pos : {0.0, 0.25, 0.5, 0.75, 0.99}) {
+        auto t0 = std::chrono::steady_clock::now();
+        size_t ops = 0;
+        for (int f = 0; f < kFrames; ++f) {
+            // Nudge the offset so every frame rebuilds the waveform layer
+            viewer.setView(pos * f64(data.endTime) + f, scale);
+            target->beginFrame();
+            viewer.paint(target.get());
+            target->endFrame();
+            auto recording = target->takeRecording();
+            ops += recording ? recording->ops().size() : 0;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / kFrames;
+        std::printf("pan %3.0f%%  %9.1f us/frame  %6zu ops/frame\n", pos * 100, us, ops / kFrames);
+    }
+    return 0;
+}
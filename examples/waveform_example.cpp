@@ -2,10 +2,13 @@
 #include "vcd_parser.hpp"
 #include "surface.hpp"
 #include "glyph_cache.hpp"
+#include "recording_file.hpp"
 #include <xcb/xcb.h>
+#include <chrono>
 #include <cstdio>
 #include <cstdint>
 #include <cstring>
+#include <thread>
 
 #if WAVEFORM_HAS_GL
 #include "context.hpp"
@@ -16,12 +19,54 @@
 
 using namespace wv;
 
-static bool parseArgs(int argc, char* argv[], bool& useGpu, const char*& path) {
+// Frames recorded while --capture is given, written out on exit for wv_replay
+struct Capture {
+    static constexpr size_t kMaxFrames = 600;
+    const char* path = nullptr;
+    std::vector<RecordingFrame> frames;
+
+    void add(WaveformViewer& viewer) {
+        if (!path || frames.size() >= kMaxFrames) return;
+        auto recorder = Surface::MakeRecording(viewer.width(), viewer.height());
+        recorder->beginFrame();
+        viewer.paint(recorder.get());
+        recorder->endFrame();
+        RecordingFrame frame;
+        frame.width = viewer.width();
+        frame.height = viewer.height();
+        frame.recording = recorder->takeRecording();
+        frames.push_back(std::move(frame));
+    }
+
+    void write() const {
+        if (!path) return;
+        if (RecordingFile::Write(path, frames)) {
+            std::printf("captured %zu frames to %s\n", frames.size(), path);
+        } else {
+            fprintf(stderr, "Failed to write %s\n", path);
+        }
+    }
+};
+
+static bool parseArgs(int argc, char* argv[], bool& useGpu, bool& async, ParseOptions& options,
+                      const char*& path, Capture& capture) {
     useGpu = false;
+    async = false;
     path = nullptr;
+    options.threads = 0;
     for (int i = 1; i < argc; ++i) {
         if (std::strcmp(argv[i], "--gpu") == 0) {
             useGpu = true;
+        } else if (std::strcmp(argv[i], "--lazy") == 0) {
+            options.lazy = true;
+        } else if (std::strcmp(argv[i], "--async") == 0) {
+            async = true;
+        } else if (std::strcmp(argv[i], "--compress") == 0) {
+            options.compress = true;
+        } else if (std::strcmp(argv[i], "--no-cache") == 0) {
+            options.cache = false;
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture.path = argv[++i];
         } else {
             path = argv[i];
         }
@@ -39,9 +84,29 @@ static void blitToXcb(xcb_connection_t* conn, xcb_window_t win, xcb_gcontext_t g
     xcb_flush(conn);
 }
 
-static int runXcb(const char* path, GlyphCache& glyphCache) {
+// Uploads only the given rects of the Pixmap
+static void blitRectsToXcb(xcb_connection_t* conn, xcb_window_t win, xcb_gcontext_t gc,
+                           const wv::Pixmap& pixmap, const std::vector<wv::Rect>& rects,
+                           std::vector<u32>& scratch) {
+    for (const auto& r : rects) {
+        i32 x = i32(r.x), y = i32(r.y), w = i32(r.w), h = i32(r.h);
+        if (w <= 0 || h <= 0) continue;
+        // put_image takes tightly packed rows
+        scratch.resize(size_t(w) * size_t(h));
+        for (i32 row = 0; row < h; ++row) {
+            std::memcpy(&scratch[size_t(row) * w], static_cast<const u32*>(pixmap.rowAddr(y + row)) + x,
+                        size_t(w) * 4);
+        }
+        xcb_put_image(conn, XCB_IMAGE_FORMAT_Z_PIXMAP, win, gc, u16(w), u16(h), int16_t(x), int16_t(y), 0, 24,
+                      u32(scratch.size() * 4), reinterpret_cast<const u8*>(scratch.data()));
+    }
+    xcb_flush(conn);
+}
+
+static int runXcb(const char* path, const ParseOptions& options, bool async, GlyphCache& glyphCache,
+                  Capture& capture) {
     VcdParser parser;
-    if (!parser.parse(path)) return 1;
+    if (!parser.parse(path, options)) return 1;
 
     xcb_connection_t* conn = xcb_connect(nullptr, nullptr);
     auto setup = xcb_get_setup(conn);
@@ -72,34 +137,60 @@ static int runXcb(const char* path, GlyphCache& glyphCache) {
         return 1;
     }
     surface->setGlyphCache(&glyphCache);
+    // Frames only redraw and upload what changed (WaveformViewer::damage)
+    surface->setRetainContents(true);
 
     WaveformViewer viewer;
     viewer.setSize(800, 600);
     viewer.setData(&parser.data());
+    viewer.setRecordThreads(0);
+    viewer.setAsync(async);
+    viewer.setScrollReuse(true);
 
-    auto renderAndBlit = [&]() {
+    std::vector<u32> blitScratch;
+    auto renderAndBlit = [&](bool exposed) {
         surface->beginFrame();
         viewer.paint(surface.get());
         surface->endFrame();
         surface->flush();
-        blitToXcb(conn, win, gc, *surface->peekPixels());
+        // Exposed windows lost their contents; upload all of it
+        if (exposed) {
+            blitToXcb(conn, win, gc, *surface->peekPixels());
+        } else {
+            blitRectsToXcb(conn, win, gc, *surface->peekPixels(), viewer.damage(), blitScratch);
+        }
+        capture.add(viewer);
     };
 
     bool running = true;
     while (running) {
-        xcb_generic_event_t* ev = xcb_wait_for_event(conn);
+        xcb_generic_event_t* ev = nullptr;
+        if (viewer.rebuildPending()) {
+            // Async rebuild in flight: poll so its result shows when it lands
+            ev = xcb_poll_for_event(conn);
+            if (!ev && !xcb_connection_has_error(conn)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                if (viewer.needsRepaint()) {
+                    renderAndBlit(false);
+                    viewer.clearRepaintFlag();
+                }
+                continue;
+            }
+        } else {
+            ev = xcb_wait_for_event(conn);
+        }
         if (!ev) break;
 
         switch (ev->response_type & ~0x80) {
             case XCB_EXPOSE:
-                renderAndBlit();
+                renderAndBlit(true);
                 break;
             case XCB_CONFIGURE_NOTIFY: {
                 auto* cfg = reinterpret_cast<xcb_configure_notify_event_t*>(ev);
                 viewer.setSize(cfg->width, cfg->height);
                 surface->resize(cfg->width, cfg->height);
                 viewer.setData(&parser.data());
-                renderAndBlit();
+                renderAndBlit(true);
                 break;
             }
             case XCB_BUTTON_PRESS: {
@@ -134,11 +225,12 @@ static int runXcb(const char* path, GlyphCache& glyphCache) {
         free(ev);
 
         if (viewer.needsRepaint()) {
-            renderAndBlit();
+            renderAndBlit(false);
             viewer.clearRepaintFlag();
         }
     }
 
+    capture.write();
     xcb_free_gc(conn, gc);
     xcb_destroy_window(conn, win);
     xcb_disconnect(conn);
@@ -151,9 +243,10 @@ static XVisualInfo* chooseGlVisual(Display* dpy) {
     return glXChooseVisual(dpy, DefaultScreen(dpy), attribs);
 }
 
-static int runGl(const char* path, GlyphCache& glyphCache) {
+static int runGl(const char* path, const ParseOptions& options, bool async, GlyphCache& glyphCache,
+                 Capture& capture) {
     VcdParser parser;
-    if (!parser.parse(path)) return 1;
+    if (!parser.parse(path, options)) return 1;
 
     Display* dpy = XOpenDisplay(nullptr);
     if (!dpy) return 1;
@@ -193,10 +286,15 @@ static int runGl(const char* path, GlyphCache& glyphCache) {
         return 1;
     }
     surface->setGlyphCache(&glyphCache);
+    // Batch by type and color: fewer buffer uploads and draw calls
+    surface->setDrawPass(true);
+    surface->setCollectSubmitStats(true);
 
     WaveformViewer viewer;
     viewer.setSize(800, 600);
     viewer.setData(&parser.data());
+    viewer.setRecordThreads(0);
+    viewer.setAsync(async);
 
     auto renderAndPresent = [&]() {
         surface->beginFrame();
@@ -204,10 +302,20 @@ static int runGl(const char* path, GlyphCache& glyphCache) {
         surface->endFrame();
         surface->flush();
         glXSwapBuffers(dpy, win);  // Host presents
+        capture.add(viewer);
     };
 
     bool running = true;
     while (running) {
+        if (viewer.rebuildPending() && !XPending(dpy)) {
+            // Async rebuild in flight: poll so its result shows when it lands
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            if (viewer.needsRepaint()) {
+                renderAndPresent();
+                viewer.clearRepaintFlag();
+            }
+            continue;
+        }
         XEvent ev;
         XNextEvent(dpy, &ev);
 
@@ -253,6 +361,16 @@ static int runGl(const char* path, GlyphCache& glyphCache) {
         }
     }
 
+    const SubmitStats& stats = surface->submitStats();
+    std::printf("submits: %llu (%llu sorted), flushes %llu -> %llu, state switches %llu -> %llu\n",
+                static_cast<unsigned long long>(stats.recordings),
+                static_cast<unsigned long long>(stats.sortedRecordings),
+                static_cast<unsigned long long>(stats.recorded.flushes),
+                static_cast<unsigned long long>(stats.submitted.flushes),
+                static_cast<unsigned long long>(stats.recorded.stateSwitches),
+                static_cast<unsigned long long>(stats.submitted.stateSwitches));
+
+    capture.write();
     surface.reset();
     glXMakeCurrent(dpy, None, nullptr);
     glXDestroyContext(dpy, glxCtx);
@@ -264,8 +382,11 @@ static int runGl(const char* path, GlyphCache& glyphCache) {
 
 int main(int argc, char* argv[]) {
     bool useGpu = false;
+    bool async = false;
+    ParseOptions options;
     const char* path = nullptr;
-    if (!parseArgs(argc, argv, useGpu, path)) {
+    Capture capture;
+    if (!parseArgs(argc, argv, useGpu, async, options, path, capture)) {
         return 1;
     }
 
@@ -278,7 +399,7 @@ int main(int argc, char* argv[]) {
 
 #if WAVEFORM_HAS_GL
     if (useGpu) {
-        int result = runGl(path, glyphCache);
+        int result = runGl(path, options, async, glyphCache, capture);
         glyphCache.release();
         return result;
     }
@@ -288,7 +409,7 @@ int main(int argc, char* argv[]) {
     }
 #endif
 
-    int result = runXcb(path, glyphCache);
+    int result = runXcb(path, options, async, glyphCache, capture);
     glyphCache.release();
     return result;
 }
@@ -477,14 +477,17 @@ void GlContext::clearClip() {
     stateCache_.setScissor(false, 0, 0, 0, 0);
 }
 
-void GlContext::submit(const Recording& recording) {
+void GlContext::submit(const Recording& recording, const std::vector<u32>* order) {
     lineVertices_.clear();
     triVertices_.clear();
     textVertices_.clear();
     
     const auto& arena = recording.arena();
-    for (const auto& op : recording.ops()) {
-        applyOp(op, arena);
+    const auto& ops = recording.ops();
+    if (order) {
+        for (u32 i : *order) applyOp(ops[i], arena);
+    } else {
+        for (const auto& op : ops) applyOp(op, arena);
     }
     
     flushTriangles();
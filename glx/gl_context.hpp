@@ -53,7 +53,7 @@ public:
     bool init(i32 w, i32 h) override;
     void beginFrame() override;
     void resize(i32 w, i32 h) override;
-    void submit(const Recording& recording) override;
+    void submit(const Recording& recording, const std::vector<u32>* order = nullptr) override;
     void flush() override;
     void setGlyphCache(GlyphCache* cache) override;
 
@@ -7,6 +7,7 @@
 namespace wv {
 
 class Device;
+class Recording;
 
 class Canvas {
 public:
@@ -17,6 +18,7 @@ public:
     void drawLine(Point p1, Point p2, Color c, f32 width = 1.0f);
     void drawPolyline(const Point* pts, i32 count, Color c, f32 width = 1.0f);
     void drawText(Point p, std::string_view text, Color c);
+    void drawRecording(const Recording& recording, Point offset = {0, 0});
 
     void save();
     void restore();
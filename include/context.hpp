@@ -2,6 +2,7 @@
 
 #include "types.hpp"
 #include <memory>
+#include <vector>
 
 namespace wv {
 
@@ -19,7 +20,8 @@ public:
     virtual bool init(i32 w, i32 h) = 0;
     virtual void beginFrame() = 0;
     virtual void resize(i32 w, i32 h) = 0;
-    virtual void submit(const Recording& recording) = 0;
+    // order, when given, lists op indices to replay in place of the recorded order
+    virtual void submit(const Recording& recording, const std::vector<u32>* order = nullptr) = 0;
     virtual void flush() = 0;
     virtual void setGlyphCache(GlyphCache* cache) = 0;
 };
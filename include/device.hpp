@@ -25,6 +25,9 @@ public:
     virtual void setClipRect(Rect r) = 0;
     virtual void resetClip() = 0;
 
+    // Replays a recording shifted by offset
+    virtual void drawRecording(const Recording& recording, Point offset);
+
     virtual void setGlyphCache(GlyphCache* cache) { (void)cache; }
     virtual std::unique_ptr<Recording> finishRecording() { return nullptr; }
 };
@@ -44,6 +47,8 @@ public:
     void setClipRect(Rect r) override;
     void resetClip() override;
 
+    void drawRecording(const Recording& recording, Point offset) override;
+
     std::unique_ptr<Recording> finishRecording() override;
 
 private:
@@ -7,31 +7,74 @@
 
 namespace wv {
 
-// 64-bit sort key for DrawOp ordering
-// [63:48] clip_id    [47:40] op_type    [39:8] color_hash    [7:0] sequence
+// Sort key for DrawOp ordering: the batch the op joined. Batches are
+// numbered as they open and the sort is stable, so each batch keeps its ops
+// in recorded order.
 struct SortKey {
     u64 key;
     u32 opIndex;
     
-    static SortKey make(u16 clipId, DrawOp::Type type, Color c, u8 seq, u32 idx) {
-        u64 k = 0;
-        k |= (u64(clipId) << 48);
-        k |= (u64(static_cast<u8>(type)) << 40);
-        u32 colorHash = (u32(c.r) << 24) | (u32(c.g) << 16) | (u32(c.b) << 8) | u32(c.a);
-        k |= (u64(colorHash) << 8);
-        k |= u64(seq);
-        return {k, idx};
-    }
-    
     bool operator<(const SortKey& o) const { return key < o.key; }
 };
 
+// Buffers for DrawPass::create, kept by the caller so that per-frame sorts
+// reuse their capacity
+struct SortScratch {
+    // Ops of one type and color, and the union of their bounds
+    struct Batch {
+        u64 state;
+        Rect bounds;
+    };
+    std::vector<SortKey> keys;
+    std::vector<SortKey> tmp;
+    std::vector<Batch> batches;
+};
+
+// Batch boundaries of replaying a recording in some order. A state switch
+// is a pair of neighbouring ops that differ in type or color, or a clip op;
+// flushes are the draw calls a batching backend (GlContext) issues.
+struct PassStats {
+    u64 stateSwitches = 0;
+    u64 flushes = 0;
+};
+
+// Running totals for a Surface's submits
+struct SubmitStats {
+    u64 recordings = 0;
+    u64 sortedRecordings = 0;   // replayed through a DrawPass
+    u64 ops = 0;
+    PassStats recorded;         // as if replayed in recorded order
+    PassStats submitted;        // in the order actually replayed
+};
+
+class GlyphCache;
+
+// Groups ops of one type and color so that a batching backend flushes less,
+// without changing the pixels. Each op joins the latest earlier batch of its
+// type and color, unless a batch opened after that one overlaps it; then it
+// opens a new batch. Clip ops are batches of their own that nothing moves
+// across.
 class DrawPass {
 public:
-    static DrawPass create(const Recording& recording);
+    // Below this many ops the sort costs more than the batching saves
+    static constexpr size_t kMinOps = 128;
+    // Batches an op looks back through for one to join
+    static constexpr size_t kMaxLookback = 32;
+    
+    // Text is measured with glyphs when given; otherwise its recorded,
+    // open-ended bounds keep everything to its right and below in place
+    static DrawPass create(const Recording& recording, SortScratch* scratch = nullptr,
+                           GlyphCache* glyphs = nullptr);
+    
+    // Stable LSD radix sort on SortKey::key, one byte per pass; passes over
+    // bytes that are equal in every key are skipped. tmp is resized as needed.
+    static void sortKeys(std::vector<SortKey>& keys, std::vector<SortKey>& tmp);
     
     const std::vector<u32>& sortedIndices() const { return sortedIndices_; }
     
+    // Stats for replaying in the given order (null: recorded order)
+    static PassStats measure(const Recording& recording, const std::vector<u32>* order);
+    
 private:
     std::vector<u32> sortedIndices_;
 };
@@ -32,11 +32,17 @@ public:
     i32 lineHeight() const { return lineHeight_; }
     i32 ascent() const { return ascent_; }
     
+    // clip, when given, further limits the pixels written
     void drawText(u32* pixels, i32 stride, i32 bufH,
-                  i32 x, i32 y, std::string_view text, Color c);
+                  i32 x, i32 y, std::string_view text, Color c, const Rect* clip = nullptr);
     
     i32 measureText(std::string_view text);
     
+    // Pixels drawText(x, y, text) can write, [x, x + w) x [y, y + h); empty
+    // if none. Rasterizes missing glyphs, after which drawing the same text
+    // only reads the cache and may run on several threads at once.
+    Rect textBounds(i32 x, i32 y, std::string_view text);
+    
 private:
     std::vector<u8> fontData_;
     void* fontInfo_ = nullptr;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.hpp"
+#include <string>
+#include <string_view>
+
+namespace wv {
+
+// Read-only memory mapping of a whole file.
+// A zero-length file maps successfully with an empty view.
+class MappedFile {
+public:
+    static MappedFile Open(const std::string& path);
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool valid() const { return valid_; }
+    const char* data() const { return static_cast<const char*>(addr_); }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data(), size_}; }
+
+    void reset();
+
+private:
+    void* addr_ = nullptr;
+    size_t size_ = 0;
+    bool valid_ = false;
+};
+
+}
@@ -67,6 +67,8 @@ public:
     const void* rowAddr(i32 y) const { return addr8() + y * info_.stride; }
 
     void clear(Color c);
+    // Reorders the pixels in place into the other byte order
+    void convert(PixelFormat format);
 
     void reset();
     void reallocate(const PixmapInfo& info);
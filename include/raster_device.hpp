@@ -2,6 +2,8 @@
 
 #include "device.hpp"
 #include "pixmap.hpp"
+#include "span_kernels.hpp"
+#include <climits>
 
 namespace wv {
 
@@ -26,19 +28,46 @@ public:
     void resetClip() override;
 
     void setGlyphCache(GlyphCache* cache) override { glyphCache_ = cache; }
+    
+    // Row kernels for fills; SpanKernels::Get() unless overridden
+    void setSpanKernels(const SpanKernels& kernels) { kernels_ = &kernels; }
+
+    // Limits drawing to pixels [x1, x2) x [y1, y2) of the target on top of
+    // the clip; TiledRaster draws each tile through a device bounded to it
+    void setBounds(i32 x1, i32 y1, i32 x2, i32 y2) { bounds_ = {x1, y1, x2, y2}; }
+    void resetBounds() { bounds_ = {}; }
+
+    // beginFrame leaves the previous frame's pixels instead of clearing
+    void setRetainContents(bool retain) { retainContents_ = retain; }
+    bool retainContents() const { return retainContents_; }
+
+    Pixmap* target() const { return target_; }
+    GlyphCache* glyphCache() const { return glyphCache_; }
+    const SpanKernels& spanKernels() const { return *kernels_; }
+    const Rect* clipRect() const { return hasClip_ ? &clipRect_ : nullptr; }
 
 private:
     Pixmap* target_ = nullptr;
     GlyphCache* glyphCache_ = nullptr;
+    const SpanKernels* kernels_ = nullptr;
 
     Rect clipRect_ = {};
     bool hasClip_ = false;
+    bool retainContents_ = false;
+
+    struct Bounds { i32 x1 = 0, y1 = 0, x2 = INT_MAX, y2 = INT_MAX; };
+    Bounds bounds_;
 
     void blendPixel(i32 x, i32 y, Color c);
     void drawHLine(i32 x1, i32 x2, i32 y, Color c);
+    void drawVLine(i32 x, i32 y1, i32 y2, Color c);
+    // Rows y1..y2, columns x1..x2 (exclusive), already clipped
+    void fillSpans(i32 x1, i32 x2, i32 y1, i32 y2, Color c);
     void drawLineImpl(i32 x1, i32 y1, i32 x2, i32 y2, Color c);
 
     bool isClipped(i32 x, i32 y) const;
+    // Pixels drawing may touch under the clip and bounds; false if none
+    bool drawableArea(i32& x1, i32& y1, i32& x2, i32& y2) const;
     Rect effectiveClip() const;
 };
 
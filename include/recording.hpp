@@ -6,6 +6,8 @@
 #include <vector>
 #include <memory>
 #include <cstring>
+#include <mutex>
+#include <atomic>
 
 namespace wv {
 
@@ -30,13 +32,28 @@ struct DrawOp {
     f32 width = 1.0f;
 };
 
-// Arena allocator for DrawOp string and point data
+class RecordingPool;
+
+// Arena allocator for DrawOp string and point data. Data lives in a linked
+// list of fixed-size chunks that never move once allocated. An offset holds
+// a slot index in its high bits and the byte within that slot's chunk in
+// its low bits; an allocation larger than a chunk gets a chunk of its own
+// that spans several slots. With a pool, chunks are taken from and returned
+// to it.
 class DrawOpArena {
 public:
-    explicit DrawOpArena(size_t initialCapacity = 4096);
+    static constexpr u32 kChunkShift = 14;
+    static constexpr size_t kChunkSize = size_t(1) << kChunkShift;
+    
+    explicit DrawOpArena(RecordingPool* pool = nullptr);
+    ~DrawOpArena();
+    DrawOpArena(DrawOpArena&& other) noexcept;
+    DrawOpArena& operator=(DrawOpArena&& other) noexcept;
+    DrawOpArena(const DrawOpArena&) = delete;
+    DrawOpArena& operator=(const DrawOpArena&) = delete;
     
     // Allocate raw bytes, returns offset
-    u32 allocate(size_t bytes);
+    u32 allocate(size_t bytes, size_t align = 1);
     
     // Store string, returns offset
     u32 storeString(std::string_view str);
@@ -47,14 +64,31 @@ public:
     // Access stored data
     const char* getString(u32 offset) const;
     const Point* getPoints(u32 offset) const;
+    Point* getPoints(u32 offset);
     
+    // Releases the chunks; the slot table keeps its capacity
     void reset();
     
+    RecordingPool* pool() const { return pool_; }
+    
 private:
-    std::vector<u8> data_;
+    friend class RecordingPool;
+    
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+        u8* data() { return reinterpret_cast<u8*>(this + 1); }
+    };
+    static Chunk* newChunk(size_t size);
+    
+    RecordingPool* pool_ = nullptr;
+    Chunk* head_ = nullptr;
+    Chunk* tail_ = nullptr;
+    size_t used_ = 0;            // bytes used in tail_
+    std::vector<u8*> slots_;     // chunk data by slot, null past an oversized chunk's first
 };
 
-// Compact DrawOp structure - 28 bytes
+// Compact DrawOp structure - 44 bytes
 struct CompactDrawOp {
     DrawOp::Type type;      // 4 bytes (enum)
     Color color;            // 4 bytes
@@ -70,24 +104,101 @@ struct CompactDrawOp {
 
         Data() : fill{{}} {}
     } data;                 // 16 bytes
+    
+    // Conservative area the op can touch. Text extends without bound to
+    // the right and below its position; clip ops are unbounded.
+    Rect bounds;            // 16 bytes
 };
-// Total: 28 bytes
+// Total: 44 bytes
 
+// Recordings whose arena has a pool hand their op vector and arena back to
+// it when destroyed. The objects themselves are recycled by the shared pool.
 class Recording {
 public:
-    Recording(std::vector<CompactDrawOp> ops, DrawOpArena arena);
+    Recording(std::vector<CompactDrawOp> ops, DrawOpArena arena, u64 culledOps = 0);
+    ~Recording();
 
     const std::vector<CompactDrawOp>& ops() const { return ops_; }
     const DrawOpArena& arena() const { return arena_; }
+    // Ops the Recorder dropped because they could not touch a pixel
+    u64 culledOps() const { return culledOps_; }
+
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
 
 private:
     std::vector<CompactDrawOp> ops_;
     DrawOpArena arena_;
+    u64 culledOps_ = 0;
 };
 
+// Keeps the buffers of destroyed recordings for the next Recorder::finish.
+// Thread-safe; each kind of buffer is kept up to a fixed count, beyond which
+// it is freed.
+class RecordingPool {
+public:
+    RecordingPool();
+    ~RecordingPool();
+    RecordingPool(const RecordingPool&) = delete;
+    RecordingPool& operator=(const RecordingPool&) = delete;
+    
+    // Used by Recorders created without a pool
+    static RecordingPool& shared();
+    
+    // Swaps in a recycled op vector and arena (both empty) if there are any
+    void acquire(std::vector<CompactDrawOp>& ops, DrawOpArena& arena);
+    void recycle(std::vector<CompactDrawOp>& ops, DrawOpArena& arena);
+    
+    DrawOpArena::Chunk* takeChunk();
+    void recycleChunk(DrawOpArena::Chunk* chunk);
+    
+    void* takeRecordingBlock(size_t size);
+    void recycleRecordingBlock(void* block);
+    
+    // Buffers currently held for reuse
+    size_t bufferCount() const;
+    size_t chunkCount() const;
+    
+    // Heap allocations made for recordings on this pool: arena chunks and
+    // Recording objects it had none to hand out for, and op vectors or
+    // arena slot tables that grew (counted once per recording)
+    u64 allocations() const { return allocations_.load(std::memory_order_relaxed); }
+    void countAllocation() { allocations_.fetch_add(1, std::memory_order_relaxed); }
+    
+private:
+    static constexpr size_t kMaxBuffers = 64;
+    static constexpr size_t kMaxChunks = 256;
+    static constexpr size_t kMaxRecordingBlocks = 64;
+    
+    struct Buffers {
+        std::vector<CompactDrawOp> ops;
+        DrawOpArena arena;
+    };
+    struct Block { Block* next; };
+    
+    mutable std::mutex mutex_;
+    std::vector<Buffers> buffers_;
+    DrawOpArena::Chunk* chunks_ = nullptr;
+    size_t chunkCount_ = 0;
+    Block* blocks_ = nullptr;
+    size_t blockCount_ = 0;
+    std::atomic<u64> allocations_{0};
+};
+
+// Ops whose bounds miss the current clip or the viewport are dropped when
+// recorded (culled) unless culling is turned off.
 class Recorder {
 public:
+    explicit Recorder(RecordingPool* pool = &RecordingPool::shared());
+    
     void reset();
+    
+    // Area of the target surface; unbounded by default
+    void setViewport(Rect r);
+    void setCulling(bool enabled) { culling_ = enabled; }
+    bool culling() const { return culling_; }
+    // Ops culled since the last reset or finish
+    u64 culledOps() const { return culledOps_; }
 
     void fillRect(Rect r, Color c);
     void strokeRect(Rect r, Color c, f32 width);
@@ -97,11 +208,29 @@ public:
     void setClip(Rect r);
     void clearClip();
 
+    // Copies another recording's ops shifted by offset; its arena data is
+    // re-stored in this recorder's arena. Its clips are intersected with
+    // the clip set here, which is active again after it
+    void append(const Recording& recording, Point offset);
+
     std::unique_ptr<Recording> finish();
 
 private:
+    RecordingPool* pool_;
     std::vector<CompactDrawOp> ops_;
     DrawOpArena arena_;
+    size_t opsCapacity_ = 0;    // as acquired, to count growth
+    
+    Rect viewport_;
+    bool hasClip_ = false;
+    Rect clip_ = {};
+    Rect active_;               // clip within viewport
+    bool culling_ = true;
+    u64 culledOps_ = 0;
+    
+    void updateActive();
+    // False (and counted) when bounds miss the active area
+    bool keep(const Rect& bounds);
 };
 
 }
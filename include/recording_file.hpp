@@ -0,0 +1,36 @@
+#pragma once
+
+#include "recording.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wv {
+
+// One captured frame: a recording and the size of the surface it was made for
+struct RecordingFrame {
+    i32 width = 0;
+    i32 height = 0;
+    std::unique_ptr<Recording> recording;
+};
+
+// Binary file of captured frames, for replaying them without the source dump.
+//
+// Layout (little-endian):
+//   Header     magic, version, frame count
+//   Per frame  surface size, op count and payload size, then the ops as
+//              fixed-size records, then the payload: the point arrays and
+//              strings of the ops' arena data, which polyline and text ops
+//              address by offset into the payload
+//
+// Arena data is written per op, so files do not depend on the arena's chunk
+// layout.
+class RecordingFile {
+public:
+    static bool Write(const std::string& path, const std::vector<RecordingFrame>& frames);
+
+    // Fails if the file is missing, malformed or of another version
+    static bool Read(const std::string& path, std::vector<RecordingFrame>& frames);
+};
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "types.hpp"
+#include "pixmap.hpp"
+
+namespace wv {
+
+enum class SpanIsa {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+// Row kernels for the software rasterizer. Pixels are packed in the
+// target's byte order (PackColor). Every instruction set gives the same
+// pixels; Get() picks the widest one the CPU supports, once.
+struct SpanKernels {
+    // dst[0..count) = pixel
+    void (*fill)(u32* dst, i32 count, u32 pixel);
+    // Source-over of an opaque-channel pixel at alpha onto dst: each color
+    // channel becomes (src * alpha + dst * (255 - alpha)) / 255, rounded
+    // down, and the alpha channel 255
+    void (*blend)(u32* dst, i32 count, u32 pixel, u8 alpha);
+    // dst = src with bytes 0 and 2 swapped (RGBA <-> BGRA); dst may be src
+    void (*swizzle)(u32* dst, const u32* src, i32 count);
+
+    static const SpanKernels& Get();
+    // Falls back to the widest supported set below isa
+    static const SpanKernels& ForIsa(SpanIsa isa);
+    static SpanIsa BestIsa();
+    static const char* IsaName(SpanIsa isa);
+
+    static u32 PackColor(Color c, PixelFormat format) {
+        if (format == PixelFormat::BGRA8888) {
+            return (u32(c.a) << 24) | (u32(c.r) << 16) | (u32(c.g) << 8) | u32(c.b);
+        }
+        return (u32(c.a) << 24) | (u32(c.b) << 16) | (u32(c.g) << 8) | u32(c.r);
+    }
+};
+
+}
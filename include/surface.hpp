@@ -5,11 +5,14 @@
 #include "canvas.hpp"
 #include "context.hpp"
 #include "device.hpp"
+#include "draw_pass.hpp"
+#include "tiled_raster.hpp"
 #include <memory>
 
 namespace wv {
 
 class GlyphCache;
+class SoftwareRasterDevice;
 
 class Surface {
 public:
@@ -34,14 +37,42 @@ public:
     void beginFrame();
     void endFrame();
     void submit(const Recording& recording);
+    // Raster surfaces draw only pixels [floor(x), ceil(x + w)) x
+    // [floor(y), ceil(y + h)) of area; other surfaces take the whole recording
+    void submit(const Recording& recording, const Rect& area);
     void flush();
 
+    // Replay submitted recordings of at least minOps ops in DrawPass order
+    void setDrawPass(bool enabled, size_t minOps = DrawPass::kMinOps) {
+        drawPass_ = enabled;
+        drawPassMinOps_ = minOps;
+    }
+    bool drawPass() const { return drawPass_; }
+    // Submit stats cost a pass over each recording (two when sorted), so
+    // they are only kept once enabled
+    void setCollectSubmitStats(bool enabled) { collectSubmitStats_ = enabled; }
+    const SubmitStats& submitStats() const { return submitStats_; }
+    void resetSubmitStats() { submitStats_ = {}; }
+
+    // Raster surfaces: threads replaying submitted recordings tile by tile
+    // (1 = the whole pixmap on the calling thread, 0 = one per hardware
+    // thread). The pixels do not depend on it.
+    void setRasterThreads(i32 threads, i32 tileWidth = TiledRaster::kTileWidth,
+                          i32 tileHeight = TiledRaster::kTileHeight);
+    i32 rasterThreads() const { return tiled_ ? tiled_->threads() : 1; }
+
+    // Raster surfaces: beginFrame keeps the last frame's pixels, so a host
+    // can redraw and upload only what changed
+    void setRetainContents(bool retain);
+    bool retainContents() const;
+
     // Pixel access (raster surfaces only, returns nullptr for GPU/recording)
     Pixmap* peekPixels();
     const Pixmap* peekPixels() const;
 
     std::unique_ptr<Recording> takeRecording();
     void setGlyphCache(GlyphCache* cache);
+    GlyphCache* glyphCache() const { return glyphCache_; }
 
 private:
     Surface(std::unique_ptr<Device> device,
@@ -52,6 +83,17 @@ private:
     std::unique_ptr<Canvas> canvas_;
     std::unique_ptr<Context> context_;
     std::unique_ptr<Pixmap> pixmap_;
+    GlyphCache* glyphCache_ = nullptr;
+    bool drawPass_ = false;
+    size_t drawPassMinOps_ = DrawPass::kMinOps;
+    bool collectSubmitStats_ = false;
+    SubmitStats submitStats_;
+    SortScratch sortScratch_;
+    SoftwareRasterDevice* raster_ = nullptr;    // device_, on raster surfaces
+    std::unique_ptr<TiledRaster> tiled_;
+    
+    void submit(const Recording& recording, const Rect* area);
+    void replay(const Recording& recording, const std::vector<u32>* order);
 };
 
 }
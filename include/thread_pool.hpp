@@ -0,0 +1,46 @@
+#pragma once
+
+#include "types.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wv {
+
+// Fixed set of worker threads for fork-join loops. The calling thread takes
+// part as worker 0, so a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+    // threads <= 0: one per hardware thread
+    explicit ThreadPool(i32 threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    i32 size() const { return i32(threads_.size()) + 1; }
+
+    // Calls fn(index, worker) for every index in [0, count), worker being in
+    // [0, size()). Returns once all calls have finished.
+    void parallelFor(size_t count, const std::function<void(size_t, i32)>& fn);
+
+private:
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t, i32)>* job_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_{0};
+    u64 generation_ = 0;
+    i32 active_ = 0;
+    bool stop_ = false;
+
+    void workerLoop(i32 worker);
+    void run(i32 worker);
+};
+
+}
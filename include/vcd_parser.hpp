@@ -1,26 +1,106 @@
 #pragma once
 
 #include "waveform_data.hpp"
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace wv {
 
+enum class ParseMode {
+    Stream,   // std::getline over an ifstream (works on pipes)
+    Mapped,   // mmap the file and tokenize in place
+};
+
+struct ParseOptions {
+    i32 threads = 1;                   // 0 = one per hardware thread
+    ParseMode mode = ParseMode::Mapped;
+    // Parse only the header plus a chunk index of the value section; signal
+    // changes are then loaded on demand through WaveformData::ensureLoaded.
+    // Requires ParseMode::Mapped (falls back to a full parse otherwise).
+    bool lazy = false;
+    // Reuse <file>.wvc (see WaveformCache) when its recorded source size and
+    // mtime still match; full parses write it. Lazy opens only read it.
+    // Off always parses the text and leaves no file behind.
+    bool cache = true;
+    // Keep change times in delta-compressed blocks (SignalChanges::compress)
+    bool compress = false;
+};
+
+// Maps VCD identifier codes to signal indices without hashing or allocating.
+// Codes of up to kMaxDirectLength printable characters ('!'..'~') are decoded
+// as bijective base-94 numbers into a flat index table; longer codes, or codes
+// with other bytes, go through a hash map.
+class VcdIdTable {
+public:
+    static constexpr size_t kNotFound = size_t(-1);
+    static constexpr size_t kMaxDirectLength = 3;
+
+    void build(const std::vector<Signal>& signals);
+    void clear();
+
+    size_t find(std::string_view id) const {
+        if (!id.empty() && id.size() <= directLength_) {
+            u32 key = 0;
+            bool direct = true;
+            for (char c : id) {
+                u32 digit = u32(static_cast<unsigned char>(c)) - 33;
+                if (digit >= 94) { direct = false; break; }
+                key = key * 94 + digit + 1;
+            }
+            if (direct) {
+                u32 index = table_[key];
+                return index == kEmpty ? kNotFound : index;
+            }
+        }
+        return findFallback(id);
+    }
+
+private:
+    static constexpr u32 kEmpty = ~0u;
+
+    std::vector<u32> table_;
+    size_t directLength_ = 0;
+    // Keys view into keys_, a copy of the fallback ids made by build();
+    // copies of the table share it, so they outlive the signals it was
+    // built from
+    std::shared_ptr<const std::string> keys_;
+    std::unordered_map<std::string_view, size_t> fallback_;
+
+    size_t findFallback(std::string_view id) const;
+};
+
 class VcdParser {
 public:
+    VcdParser() = default;
+    VcdParser(const VcdParser&) = delete;
+    VcdParser& operator=(const VcdParser&) = delete;
+
     bool parse(const std::string& filename);
+    bool parse(const std::string& filename, ParseMode mode);
+    bool parse(const std::string& filename, const ParseOptions& options);
     const WaveformData& data() const { return data_; }
-    
+    WaveformData& data() { return data_; }
+
 private:
     WaveformData data_;
-    std::unordered_map<std::string, size_t> signalIndex_;
-    
-    void parseHeader(std::istream& is);
-    void parseValues(std::istream& is);
-    Signal* findSignal(const std::string& id);
-    static std::string trim(const std::string& s);
-    bool parseTimescaleToken(const std::string& token);
-    bool parseTimescaleParts(const std::string& value, const std::string& unit);
+    VcdIdTable signalIndex_;  // rebuilt once the header is done
+
+    bool parseStream(const std::string& filename);
+    bool parseMapped(const std::string& filename, i32 threads);
+    bool parseLazy(const std::string& filename, i32 threads);
+    bool parseHeaderLine(std::string_view line, std::vector<std::string>& scope);
+    void parseValues(const char* begin, const char* end);
+    void parseValuesParallel(const char* begin, const char* end, i32 threads);
+    void buildSignalIndex();
+    void buildLods(i32 threads);
+    void compressChanges();
+    static constexpr size_t kNoSignal = VcdIdTable::kNotFound;
+    size_t findSignalIndex(std::string_view id) const { return signalIndex_.find(id); }
+    bool parseTimescaleToken(std::string_view token);
+    bool parseTimescaleParts(std::string_view value, std::string_view unit);
 };
 
 }
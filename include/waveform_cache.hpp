@@ -0,0 +1,42 @@
+#pragma once
+
+#include "waveform_data.hpp"
+#include <string>
+
+namespace wv {
+
+// Identity of a source dump; a cache is reused only while both still match.
+struct CacheStamp {
+    u64 size = 0;
+    u64 mtimeNs = 0;
+
+    static bool Stat(const std::string& path, CacheStamp& out);
+    bool operator==(const CacheStamp& o) const { return size == o.size && mtimeNs == o.mtimeNs; }
+};
+
+// Binary on-disk copy of a WaveformData.
+//
+// Layout (little-endian):
+//   Header       magic, version, source stamp, timescale, endTime, counts,
+//                offsets of the tables below
+//   Signal table one fixed-size entry per signal: name/id location, width,
+//                radix, change count and the offsets of its two columns
+//   String table names and ids, back to back
+//   Columns      per signal: times as LEB128 deltas, then values as a packed
+//                bitset (when every value is 0/1) or raw u64s
+//
+// Open() maps the file and reads only the header and signal table; columns
+// are decoded straight from the mapping when a signal is first needed.
+class WaveformCache {
+public:
+    static std::string PathFor(const std::string& sourcePath) { return sourcePath + ".wvc"; }
+
+    static bool Write(const std::string& path, const WaveformData& data, const CacheStamp& source);
+
+    // Fails if the file is missing, malformed or was written for another source.
+    // With lazy set, signal changes load on demand via data.loader.
+    static bool Open(const std::string& path, const CacheStamp& source, WaveformData& data,
+                     bool lazy);
+};
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "types.hpp"
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -13,18 +17,246 @@ struct SignalChange {
     u64 value;
 };
 
+// Columnar storage for a signal's value changes. Times and values are kept
+// in separate arrays so time-only searches touch 8 bytes per change. Values
+// stay in a packed bitset while every value is 0/1 (scalar signals) and move
+// to a u64 array on the first wider value.
+//
+// compress() switches the time column to blocks of kBlockSize changes: each
+// block stores its first time in a header and the rest as LEB128 deltas.
+// Random access is then a header binary search plus one partial block decode;
+// iterate with begin()/end() (or seek()) to stream through a range instead.
+class SignalChanges {
+public:
+    static constexpr size_t kBlockSize = 128;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = SignalChange;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = SignalChange;
+
+        const_iterator() = default;
+        const_iterator(const SignalChanges* owner, size_t index) : owner_(owner) { seek(index); }
+
+        size_t index() const { return index_; }
+        u64 time() const { return time_; }
+        u64 value() const { return owner_->value(index_); }
+
+        SignalChange operator*() const { return {time_, value()}; }
+        SignalChange operator[](difference_type n) const { return *(*this + n); }
+        const_iterator& operator++() {
+            ++index_;
+            if (index_ < owner_->size()) {
+                if (!owner_->compressed_) {
+                    time_ = owner_->times_[index_];
+                } else if (index_ % kBlockSize == 0) {
+                    const Block& block = owner_->blocks_[index_ / kBlockSize];
+                    time_ = block.firstTime;
+                    pos_ = block.offset;
+                } else {
+                    time_ += readDelta(owner_->deltas_, pos_);
+                }
+            }
+            return *this;
+        }
+        const_iterator operator++(int) { auto it = *this; ++*this; return it; }
+        const_iterator& operator--() { seek(index_ - 1); return *this; }
+        const_iterator operator--(int) { auto it = *this; --*this; return it; }
+        const_iterator& operator+=(difference_type n) { seek(index_ + n); return *this; }
+        const_iterator& operator-=(difference_type n) { seek(index_ - n); return *this; }
+        const_iterator operator+(difference_type n) const { return {owner_, index_ + n}; }
+        const_iterator operator-(difference_type n) const { return {owner_, index_ - n}; }
+        difference_type operator-(const const_iterator& o) const {
+            return difference_type(index_) - difference_type(o.index_);
+        }
+        bool operator==(const const_iterator& o) const { return index_ == o.index_; }
+        bool operator!=(const const_iterator& o) const { return index_ != o.index_; }
+        bool operator<(const const_iterator& o) const { return index_ < o.index_; }
+
+    private:
+        const SignalChanges* owner_ = nullptr;
+        size_t index_ = 0;
+        u64 time_ = 0;
+        size_t pos_ = 0;    // next delta byte when compressed
+
+        void seek(size_t index) {
+            index_ = index;
+            if (index_ < owner_->size()) time_ = owner_->decodeTime(index_, &pos_);
+        }
+    };
+
+    SignalChanges() = default;
+    SignalChanges(std::initializer_list<SignalChange> changes);
+
+    // Adopts ready-made columns; valueWords is a bitset when packed is set.
+    static SignalChanges FromColumns(std::vector<u64> times, std::vector<u64> valueWords, bool packed);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    u64 time(size_t i) const { return compressed_ ? decodeTime(i, nullptr) : times_[i]; }
+    u64 value(size_t i) const {
+        return packed_ ? (values_[i >> 6] >> (i & 63)) & 1 : values_[i];
+    }
+    SignalChange operator[](size_t i) const { return {time(i), value(i)}; }
+    SignalChange front() const { return (*this)[0]; }
+    SignalChange back() const { return {lastTime_, value(count_ - 1)}; }
+
+    // First change with time >= t (lowerBound) or > t (upperBound); size() if none
+    size_t lowerBound(u64 t) const;
+    size_t upperBound(u64 t) const;
+    // Same result, searching outward from a previous answer: O(log d) for
+    // an answer d changes away, so small cursor moves are O(1)
+    size_t upperBound(u64 t, size_t hint) const;
+
+    bool packed() const { return packed_; }
+    bool compressed() const { return compressed_; }
+    // Bitset words when packed(), one value per change otherwise
+    const std::vector<u64>& valueWords() const { return values_; }
+
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+    const_iterator seek(size_t index) const { return {this, index}; }
+
+    void push_back(SignalChange change) {
+        if (packed_ && change.value > 1) unpack();
+        size_t i = count_++;
+        if (!compressed_) {
+            times_.push_back(change.time);
+        } else {
+            appendCompressedTime(i, change.time);
+        }
+        lastTime_ = change.time;
+        if (!packed_) {
+            values_.push_back(change.value);
+        } else {
+            if ((i & 63) == 0) values_.push_back(0);
+            values_.back() |= change.value << (i & 63);
+        }
+    }
+    void reserve(size_t n);
+    void clear();
+    void shrink_to_fit();
+
+    // Re-encodes the time column as delta blocks; later push_backs stay compressed
+    void compress();
+
+    size_t memoryBytes() const;
+
+private:
+    struct Block {
+        u64 firstTime;
+        u64 offset;     // into deltas_ for the block's second change
+    };
+
+    std::vector<u64> times_;    // flat column, unused when compressed
+    std::vector<Block> blocks_;
+    std::vector<u8> deltas_;
+    std::vector<u64> values_;
+    size_t count_ = 0;
+    u64 lastTime_ = 0;
+    bool packed_ = true;
+    bool compressed_ = false;
+
+    static u64 readDelta(const std::vector<u8>& bytes, size_t& pos) {
+        u64 v = 0;
+        for (u32 shift = 0;; shift += 7) {
+            u8 b = bytes[pos++];
+            v |= u64(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+    }
+
+    u64 decodeTime(size_t i, size_t* nextPos) const;
+    void appendCompressedTime(size_t i, u64 time);
+    void unpack();
+};
+
+// Multi-resolution summary of a signal for zoomed-out drawing. Level L
+// groups changes into time buckets of (1 << shift(L)) units; each level is
+// sparse (only buckets holding changes are stored) and has half the
+// resolution of the one below. Signals with few changes get no levels.
+class SignalLod {
+public:
+    struct Bucket {
+        u64 index;      // bucket start time >> shift
+        u64 count;      // changes in the bucket
+        u64 first;      // value after the first change
+        u64 last;       // value after the last change
+        u64 min;        // smallest and largest value a change set
+        u64 max;
+    };
+
+    // Below this many changes raw drawing is already cheap
+    static constexpr size_t kMinChanges = 256;
+    // Average changes per bucket at the finest level
+    static constexpr u64 kChangesPerBucket = 16;
+
+    void build(const SignalChanges& changes);
+    void clear() { levels_.clear(); }
+
+    bool empty() const { return levels_.empty(); }
+    size_t levelCount() const { return levels_.size(); }
+    u32 shift(size_t level) const { return baseShift_ + u32(level); }
+    const std::vector<Bucket>& level(size_t level) const { return levels_[level]; }
+
+    // Coarsest level whose buckets span at most maxSpan time units, or -1
+    // when even the finest level is coarser than that
+    i32 levelFor(f64 maxSpan) const;
+
+    size_t memoryBytes() const;
+
+private:
+    u32 baseShift_ = 0;
+    std::vector<std::vector<Bucket>> levels_;
+};
+
 struct Signal {
     std::string name;
     std::string id;
     i32 width;
-    std::vector<SignalChange> changes;
+    SignalChanges changes;
     Radix radix = Radix::Hex;
+    SignalLod lod{};  // built once changes are loaded
+};
+
+struct WaveformData;
+
+// Fills in Signal::changes on demand for lazily opened dumps. A loader only
+// holds the source index: it writes into the WaveformData passed to load(),
+// and that WaveformData records which signals it has, so copies sharing a
+// loader fill in independently. Calls may come from any thread; the loader
+// serializes them.
+class SignalLoader {
+public:
+    virtual ~SignalLoader() = default;
+    void load(WaveformData& data, const size_t* indices, size_t count);
+    bool isLoaded(const WaveformData& data, size_t index) const;
+
+protected:
+    // Called under the lock with signals of data that are not loaded yet
+    virtual void loadSignals(WaveformData& data, const size_t* indices, size_t count) = 0;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<size_t> pending_;
 };
 
 struct WaveformData {
     u64 timescale = 1;
     u64 endTime = 0;
     std::vector<Signal> signals;
+    std::shared_ptr<SignalLoader> loader;  // null once everything is resident
+    std::vector<u8> loadedSignals;         // per signal while loader is set
+
+    bool isLoaded(size_t index) const { return !loader || loader->isLoaded(*this, index); }
+    void ensureLoaded(size_t index) { ensureLoaded(&index, 1); }
+    void ensureLoaded(const size_t* indices, size_t count) {
+        if (loader) loader->load(*this, indices, count);
+    }
 };
 
 }
@@ -3,13 +3,19 @@
 #include "waveform_data.hpp"
 #include "surface.hpp"
 #include "recording.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace wv {
 
 class WaveformViewer {
 public:
+    WaveformViewer();
+    ~WaveformViewer();
+    
     void setSize(i32 w, i32 h) {
         w_ = w;
         h_ = h;
@@ -20,9 +26,19 @@ public:
     i32 width() const { return w_; }
     i32 height() const { return h_; }
     
-    void setData(const WaveformData* data);
+    // Lazily opened data has the visible signals loaded into it as it is shown
+    void setData(WaveformData* data);
     void paint(Surface* target);
     
+    // View: time at the left edge of the waveform area, pixels per time unit
+    void setView(f64 timeOffset, f64 timeScale);
+    f64 timeOffset() const { return timeOffset_; }
+    f64 timeScale() const { return timeScale_; }
+    
+    // Vertical scroll: index of the signal drawn in the top row
+    void setScrollRow(i32 row);
+    i32 scrollRow() const { return firstRow_; }
+    
     void mouseDown(i32 x, i32 y);
     void mouseMove(i32 x, i32 y);
     void mouseUp();
@@ -45,14 +61,79 @@ public:
     // Keyboard input
     void keyPress(i32 keycode);
     
-    bool needsRepaint() const { return needsRepaint_; }
+    // Async mode: dirty layers are rebuilt on a background thread. paint()
+    // waits up to the frame budget for the rebuild, otherwise it shows the
+    // last finished layers (the waveform layer shifted to the new offset)
+    // and needsRepaint() turns true once the rebuild lands. Each paint that
+    // finds dirty layers starts a new generation; rebuilds of older
+    // generations are abandoned.
+    void setAsync(bool enabled);
+    bool async() const { return async_ != nullptr; }
+    void setFrameBudget(f64 milliseconds) { frameBudgetMs_ = milliseconds; }
+    u64 generation() const { return generation_; }
+    bool rebuildPending() const;
+    
+    bool needsRepaint() const { return needsRepaint_ || asyncReady_.load(); }
     void clearRepaintFlag() { needsRepaint_ = false; }
     
     // Value formatting (public for testing)
     static std::string formatValue(u64 value, i32 width, Radix radix);
     
+    // Signal rows re-recorded by the last waveform layer update
+    i32 rowsRecorded() const { return rowsRecorded_; }
+    
+    // Ops dropped at record time (outside the clip or the layer) by the last
+    // update of each layer; the waveform count includes the rows it recorded.
+    // Async rebuilds are not counted.
+    struct CulledOps {
+        u64 staticLayer = 0;
+        u64 waveformLayer = 0;
+        u64 overlayLayer = 0;
+    };
+    const CulledOps& culledOps() const { return culledOps_; }
+    
+    // Threads recording signal rows (1 = on the calling thread, 0 = one per
+    // hardware thread). Rows are composed in order, so output is identical.
+    void setRecordThreads(i32 threads);
+    
+    // Raster targets keep the static and waveform layers composed in a
+    // pixmap. A horizontal pan by whole pixels shifts it and redraws only
+    // the exposed strip and the row segments cut by the view edges. Off by
+    // default: every raster paint then also pays for a view-sized pixmap
+    // and a copy of it into the target.
+    void setScrollReuse(bool enabled);
+    bool scrollReuse() const { return scrollReuse_; }
+    // Base pixels rasterized by the last raster paint
+    u64 pixelsRedrawn() const { return pixelsRedrawn_; }
+    
+    // Target pixels the last paint changed, as disjoint whole-pixel rects.
+    // With scroll reuse on, a raster target that retains its contents
+    // (Surface::setRetainContents) and saw only overlay changes, such as a cursor move, since the last
+    // paint gets the old and new overlay areas; otherwise the whole view.
+    const std::vector<Rect>& damage() const { return damage_; }
+    
+    // Scalar rows drawn change by change emit one edge per pixel column
+    // however many changes share it; the pixels are the same either way
+    void setColumnDecimation(bool enabled);
+    bool columnDecimation() const { return columnDecimation_; }
+    
 private:
-    const WaveformData* data_ = nullptr;
+    struct ViewState;
+    struct AsyncBuilder;
+    
+    std::unique_ptr<AsyncBuilder> async_;
+    std::atomic<bool> asyncReady_{false};
+    f64 frameBudgetMs_ = 8.0;
+    u64 generation_ = 0;
+    u64 dataVersion_ = 0;
+    i32 recordThreads_ = 1;
+    bool columnDecimation_ = true;
+    
+    ViewState captureState() const;
+    void applyState(const ViewState& state);
+    void paintAsync(Surface* target);
+    
+    WaveformData* data_ = nullptr;
     i32 w_ = 0, h_ = 0;
     f64 timeOffset_ = 0;
     f64 timeScale_ = 1.0;
@@ -66,9 +147,18 @@ private:
     
     f64 cursorTime_ = 0;
     i32 selectedSignal_ = -1;
+    i32 firstRow_ = 0;
     
-    void drawSignal(Canvas* c, const Signal& sig, i32 y, i32 signalIndex);
-    void drawTimeScale(Canvas* c);
+    // spanX0..spanX1 limits the ops emitted to the ones that can touch those
+    // columns; the pixels drawn there match an unlimited draw
+    void drawSignal(Canvas* c, const Signal& sig, i32 y, i32 signalIndex, f32 spanX0, f32 spanX1);
+    void drawSignalLod(Canvas* c, const Signal& sig, i32 y, i32 signalIndex, size_t level,
+                       f32 spanX0, f32 spanX1);
+    void drawBusSegment(Canvas* c, f32 x1, f32 x2, f32 high, f32 low, u64 value,
+                        i32 width, Radix radix);
+    f32 busLabelReach(const Signal& sig, Radix radix) const;
+    f32 timeLabelReach() const;
+    void drawTimeScale(Canvas* c, Rect span);
     void drawSignalNames(Canvas* c);
     void drawSignalValues(Canvas* c);
     void drawCursor(Canvas* c);
@@ -77,6 +167,9 @@ private:
         std::unique_ptr<Surface> surface;
         std::unique_ptr<Recording> recording;
         bool dirty = true;
+        bool pending = false;   // async: handed to the builder, not back yet
+        f64 timeOffset = 0;     // view the async recording was built for
+        f64 timeScale = 0;
     };
     
     Layer staticLayer_;
@@ -85,6 +178,44 @@ private:
     i32 layerW_ = 0;
     i32 layerH_ = 0;
     
+    // Rows from firstRow_ that intersect the window; only these are drawn,
+    // and lazily opened dumps load only these
+    i32 visibleRowCount() const;
+    i32 maxScrollRow() const;
+    void scrollToRow(i32 row);
+    void loadVisibleSignals();
+    std::vector<size_t> visibleIndices_;
+
+    // Each visible row is recorded once at y = 0 and composed into the
+    // waveform layer; it is re-recorded only when its key changes
+    struct RowKey {
+        f64 timeOffset;
+        f64 timeScale;
+        Radix radix;
+        i32 height;
+        i32 nameWidth;
+        i32 width;
+        size_t changeCount;  // lazily loaded signals fill in later
+        
+        bool operator==(const RowKey& o) const {
+            return timeOffset == o.timeOffset && timeScale == o.timeScale && radix == o.radix &&
+                   height == o.height && nameWidth == o.nameWidth && width == o.width &&
+                   changeCount == o.changeCount;
+        }
+    };
+    struct RowCache {
+        RowKey key = {};
+        std::unique_ptr<Recording> recording;
+    };
+    std::unordered_map<i32, RowCache> rowCache_;
+    std::vector<std::unique_ptr<Surface>> rowSurfaces_;  // one per worker
+    std::vector<i32> staleRows_;
+    std::vector<RowCache*> staleEntries_;  // rowCache_ entries of staleRows_
+    std::unique_ptr<ThreadPool> recordPool_;
+    i32 rowsRecorded_ = 0;
+    CulledOps culledOps_;
+    void recordStaleRows(i32 first, i32 end);
+    
     void ensureLayers();
     void updateStaticLayer();
     void updateWaveformLayer();
@@ -94,10 +225,36 @@ private:
     i32 findNextEdgeIndex(const Signal& sig, f64 time);
     i32 findPrevEdgeIndex(const Signal& sig, f64 time);
     
-    u64 getValueAtTime(const Signal& sig, f64 time);
+    // hint: per-signal index from the previous lookup, updated in place
+    u64 getValueAtTime(const Signal& sig, f64 time, size_t* hint = nullptr);
     Radix signalRadixForIndex(i32 index, const Signal& sig) const;
 
     std::vector<Radix> signalRadix_;
+    std::vector<size_t> valueHints_;  // cursor lookups, one per signal
+    u64 radixVersion_ = 0;
+    
+    // Static + waveform layers as last rasterized, and what they show
+    struct RasterBase {
+        std::unique_ptr<Surface> surface;
+        bool valid = false;
+        f64 timeOffset = 0, timeScale = 0;
+        i32 firstRow = 0;
+        i32 selectedSignal = -1;
+        u64 dataVersion = 0, radixVersion = 0;
+        // Target the last raster paint composed into, and the pixels its
+        // overlay covers there
+        const Surface* target = nullptr;
+        GlyphCache* glyphs = nullptr;
+        std::vector<Rect> overlayArea;
+    };
+    RasterBase rasterBase_;
+    bool scrollReuse_ = false;
+    u64 pixelsRedrawn_ = 0;
+    std::vector<Rect> damage_;
+    void paintRaster(Surface* target, Pixmap* pixels);
+    void redrawBase();
+    void panBase(i32 dx);
+    void panRedrawSpan(const Signal& sig, i32 signalIndex, i32 dx, i32* leftEnd, i32* rightStart) const;
 };
 
 }
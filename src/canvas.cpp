@@ -26,6 +26,10 @@ void Canvas::drawText(Point p, std::string_view text, Color c) {
     device_->drawText(p, text, c);
 }
 
+void Canvas::drawRecording(const Recording& recording, Point offset) {
+    device_->drawRecording(recording, offset);
+}
+
 void Canvas::save() {
     stack_.push_back(current_);
 }
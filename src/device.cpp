@@ -0,0 +1,59 @@
+#include "device.hpp"
+
+namespace wv {
+
+void Device::drawRecording(const Recording& recording, Point offset) {
+    const f32 dx = offset.x, dy = offset.y;
+    const auto& arena = recording.arena();
+    std::vector<Point> shifted;
+    for (const auto& op : recording.ops()) {
+        switch (op.type) {
+            case DrawOp::Type::FillRect: {
+                Rect r = op.data.fill.rect;
+                fillRect({r.x + dx, r.y + dy, r.w, r.h}, op.color);
+                break;
+            }
+            case DrawOp::Type::StrokeRect: {
+                Rect r = op.data.stroke.rect;
+                strokeRect({r.x + dx, r.y + dy, r.w, r.h}, op.color, op.width);
+                break;
+            }
+            case DrawOp::Type::Line: {
+                Point p1 = op.data.line.p1, p2 = op.data.line.p2;
+                drawLine({p1.x + dx, p1.y + dy}, {p2.x + dx, p2.y + dy}, op.color, op.width);
+                break;
+            }
+            case DrawOp::Type::Polyline: {
+                u32 count = op.data.polyline.count;
+                if (count == 0) break;
+                const Point* pts = arena.getPoints(op.data.polyline.offset);
+                if (dx != 0 || dy != 0) {
+                    shifted.assign(pts, pts + count);
+                    for (auto& p : shifted) {
+                        p.x += dx;
+                        p.y += dy;
+                    }
+                    pts = shifted.data();
+                }
+                drawPolyline(pts, i32(count), op.color, op.width);
+                break;
+            }
+            case DrawOp::Type::Text: {
+                Point p = op.data.text.pos;
+                drawText({p.x + dx, p.y + dy},
+                         std::string_view(arena.getString(op.data.text.offset), op.data.text.len), op.color);
+                break;
+            }
+            case DrawOp::Type::SetClip: {
+                Rect r = op.data.clip.rect;
+                setClipRect({r.x + dx, r.y + dy, r.w, r.h});
+                break;
+            }
+            case DrawOp::Type::ClearClip:
+                resetClip();
+                break;
+        }
+    }
+}
+
+}
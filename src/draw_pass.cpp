@@ -1,48 +1,77 @@
 #include "draw_pass.hpp"
+#include "glyph_cache.hpp"
+#include <utility>
 
 namespace wv {
 
-DrawPass DrawPass::create(const Recording& recording) {
+namespace {
+
+bool intersects(const Rect& a, const Rect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+Rect unite(const Rect& a, const Rect& b) {
+    f32 x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+    return {x0, y0, std::max(a.x + a.w, b.x + b.w) - x0, std::max(a.y + a.h, b.y + b.h) - y0};
+}
+
+}
+
+DrawPass DrawPass::create(const Recording& recording, SortScratch* scratch, GlyphCache* glyphs) {
     DrawPass pass;
     const auto& ops = recording.ops();
 
     if (ops.empty()) return pass;
 
-    std::vector<SortKey> keys;
+    SortScratch local;
+    if (!scratch) scratch = &local;
+    std::vector<SortKey>& keys = scratch->keys;
+    std::vector<SortScratch::Batch>& batches = scratch->batches;
+    keys.clear();
     keys.reserve(ops.size());
+    batches.clear();
 
-    u16 currentClipId = 0;
-    u8 sequence = 0;
+    const auto& arena = recording.arena();
+    size_t barrier = 0;     // first batch ops may still join
 
     for (u32 i = 0; i < ops.size(); ++i) {
         const auto& op = ops[i];
 
-        if (op.type == DrawOp::Type::SetClip) {
-            // Advance to new clip group; place SetClip at the very start
-            // (sort key with type/color/seq all zero sorts first in group)
-            ++currentClipId;
-            sequence = 0;
-            keys.push_back(SortKey::make(currentClipId, DrawOp::Type::FillRect, {}, 0, i));
-            // Bump sequence so draw ops sort after the SetClip
-            sequence = 1;
+        if (op.type == DrawOp::Type::SetClip || op.type == DrawOp::Type::ClearClip) {
+            keys.push_back({batches.size(), i});
+            batches.push_back({~u64(0), op.bounds});
+            barrier = batches.size();
             continue;
         }
-        if (op.type == DrawOp::Type::ClearClip) {
-            // Place ClearClip at the very end of the current group
-            // (sort key with max type/color/seq sorts last in group)
-            keys.push_back(SortKey::make(currentClipId,
-                static_cast<DrawOp::Type>(0xFF), {0xFF,0xFF,0xFF,0xFF}, 0xFE, i));
-            // Advance clip group so subsequent ops don't merge with this one
-            ++currentClipId;
-            sequence = 0;
-            continue;
+
+        Rect bounds = op.bounds;
+        if (op.type == DrawOp::Type::Text && glyphs) {
+            Point p = op.data.text.pos;
+            bounds = glyphs->textBounds(i32(p.x), i32(p.y),
+                std::string_view(arena.getString(op.data.text.offset), op.data.text.len));
         }
+        const u64 state = (u64(static_cast<u8>(op.type)) << 32) |
+                          (u32(op.color.r) << 24) | (u32(op.color.g) << 16) |
+                          (u32(op.color.b) << 8) | u32(op.color.a);
 
-        keys.push_back(SortKey::make(currentClipId, op.type, op.color, sequence++, i));
-        if (sequence >= 0xFE) sequence = 1;  // Reserve 0 for SetClip, 0xFE for ClearClip
+        size_t join = batches.size();
+        size_t stop = std::max(barrier, batches.size() - std::min(batches.size(), kMaxLookback));
+        for (size_t b = batches.size(); b-- > stop;) {
+            if (batches[b].state == state) {
+                join = b;
+                break;
+            }
+            if (intersects(batches[b].bounds, bounds)) break;
+        }
+        if (join == batches.size()) {
+            batches.push_back({state, bounds});
+        } else {
+            batches[join].bounds = unite(batches[join].bounds, bounds);
+        }
+        keys.push_back({join, i});
     }
 
-    std::stable_sort(keys.begin(), keys.end());
+    sortKeys(keys, scratch->tmp);
 
     pass.sortedIndices_.reserve(keys.size());
     for (const auto& key : keys) {
@@ -52,4 +81,98 @@ DrawPass DrawPass::create(const Recording& recording) {
     return pass;
 }
 
+void DrawPass::sortKeys(std::vector<SortKey>& keys, std::vector<SortKey>& tmp) {
+    size_t n = keys.size();
+    // Below a few thousand keys the passes cost more than a comparison sort
+    // (bench_sort_keys)
+    if (n < 2048) {
+        std::stable_sort(keys.begin(), keys.end());
+        return;
+    }
+    
+    // One histogram per byte, all counted in a single read
+    u32 counts[8 * 256] = {};
+    for (const SortKey& k : keys) {
+        for (int b = 0; b < 8; ++b) counts[b * 256 + ((k.key >> (b * 8)) & 0xFF)]++;
+    }
+    
+    tmp.resize(n);
+    SortKey* src = keys.data();
+    SortKey* dst = tmp.data();
+    for (int b = 0; b < 8; ++b) {
+        u32* count = &counts[b * 256];
+        if (count[(src[0].key >> (b * 8)) & 0xFF] == n) continue;
+        
+        u32 offset = 0;
+        for (int d = 0; d < 256; ++d) {
+            u32 c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+        // Scattering in input order keeps equal digits in order, so each
+        // pass, and the whole sort, is stable
+        for (size_t i = 0; i < n; ++i) {
+            dst[count[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != keys.data()) keys.swap(tmp);
+}
+
+PassStats DrawPass::measure(const Recording& recording, const std::vector<u32>* order) {
+    PassStats stats;
+    const auto& ops = recording.ops();
+    size_t count = order ? order->size() : ops.size();
+    
+    // Mirrors GlContext: fills and lines batch until text or a clip change,
+    // text batches until its color changes or a clip change
+    bool tris = false, lines = false, text = false;
+    Color textColor = {};
+    auto flush = [&stats](bool& pending) {
+        if (pending) stats.flushes++;
+        pending = false;
+    };
+    auto sameColor = [](Color a, Color b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    };
+    
+    const CompactDrawOp* prev = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const CompactDrawOp& op = ops[order ? (*order)[i] : i];
+        bool clip = op.type == DrawOp::Type::SetClip || op.type == DrawOp::Type::ClearClip;
+        if (prev && (clip || op.type != prev->type || !sameColor(op.color, prev->color))) {
+            stats.stateSwitches++;
+        }
+        prev = &op;
+        
+        switch (op.type) {
+            case DrawOp::Type::FillRect:
+                tris = true;
+                break;
+            case DrawOp::Type::StrokeRect:
+            case DrawOp::Type::Line:
+            case DrawOp::Type::Polyline:
+                lines = true;
+                break;
+            case DrawOp::Type::Text:
+                flush(tris);
+                flush(lines);
+                if (text && !sameColor(op.color, textColor)) flush(text);
+                text = true;
+                textColor = op.color;
+                break;
+            case DrawOp::Type::SetClip:
+            case DrawOp::Type::ClearClip:
+                flush(tris);
+                flush(lines);
+                flush(text);
+                break;
+        }
+    }
+    flush(tris);
+    flush(lines);
+    flush(text);
+    return stats;
+}
+
 }
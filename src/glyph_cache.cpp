@@ -1,6 +1,7 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "glyph_cache.hpp"
 #include "../third_party/stb_truetype.h"
+#include <algorithm>
 #include <fstream>
 #include <cstring>
 
@@ -124,10 +125,18 @@ bool GlyphCache::growAtlas() {
 }
 
 void GlyphCache::drawText(u32* pixels, i32 stride, i32 bufH,
-                          i32 x, i32 y, std::string_view text, Color c) {
+                          i32 x, i32 y, std::string_view text, Color c, const Rect* clip) {
     i32 penX = x;
     i32 baseline = y + ascent_;
     
+    i32 minX = 0, minY = 0, maxX = stride, maxY = bufH;
+    if (clip) {
+        minX = std::max(minX, i32(clip->x));
+        minY = std::max(minY, i32(clip->y));
+        maxX = std::min(maxX, i32(clip->x + clip->w));
+        maxY = std::min(maxY, i32(clip->y + clip->h));
+    }
+    
     for (char ch : text) {
         const GlyphMetrics* g = getGlyph(ch);
         if (!g) continue;
@@ -142,13 +151,14 @@ void GlyphCache::drawText(u32* pixels, i32 stride, i32 bufH,
             i32 srcX = i32(g->u0 * atlasW_);
             i32 srcY = i32(g->v0 * atlasH_);
             
-            for (i32 row = 0; row < glyphH; ++row) {
+            i32 rowBegin = std::max(0, minY - dstY), rowEnd = std::min(glyphH, maxY - dstY);
+            i32 colBegin = std::max(0, minX - dstX), colEnd = std::min(glyphW, maxX - dstX);
+            
+            for (i32 row = rowBegin; row < rowEnd; ++row) {
                 i32 dy = dstY + row;
-                if (dy < 0 || dy >= bufH) continue;
                 
-                for (i32 col = 0; col < glyphW; ++col) {
+                for (i32 col = colBegin; col < colEnd; ++col) {
                     i32 dx = dstX + col;
-                    if (dx < 0 || dx >= stride) continue;
                     
                     u8 alpha = atlas_[(srcY + row) * atlasW_ + srcX + col];
                     if (alpha == 0) continue;
@@ -180,4 +190,26 @@ i32 GlyphCache::measureText(std::string_view text) {
     return width;
 }
 
+Rect GlyphCache::textBounds(i32 x, i32 y, std::string_view text) {
+    i32 penX = x;
+    i32 baseline = y + ascent_;
+    i32 minX = 0, minY = 0, maxX = 0, maxY = 0;
+    bool any = false;
+    for (char ch : text) {
+        const GlyphMetrics* g = getGlyph(ch);
+        if (!g) continue;
+        if (g->x1 > g->x0 && g->y1 > g->y0) {
+            i32 x0 = penX + g->x0, y0 = baseline + g->y0;
+            i32 x1 = penX + g->x1, y1 = baseline + g->y1;
+            minX = any ? std::min(minX, x0) : x0;
+            minY = any ? std::min(minY, y0) : y0;
+            maxX = any ? std::max(maxX, x1) : x1;
+            maxY = any ? std::max(maxY, y1) : y1;
+            any = true;
+        }
+        penX += g->advance;
+    }
+    return {f32(minX), f32(minY), f32(maxX - minX), f32(maxY - minY)};
+}
+
 }
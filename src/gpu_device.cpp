@@ -2,7 +2,8 @@
 
 namespace wv {
 
-void GpuDevice::resize(i32, i32) {
+void GpuDevice::resize(i32 w, i32 h) {
+    recorder_.setViewport({0, 0, f32(w), f32(h)});
 }
 
 void GpuDevice::beginFrame() {
@@ -42,6 +43,10 @@ void GpuDevice::resetClip() {
     recorder_.clearClip();
 }
 
+void GpuDevice::drawRecording(const Recording& recording, Point offset) {
+    recorder_.append(recording, offset);
+}
+
 std::unique_ptr<Recording> GpuDevice::finishRecording() {
     return std::move(recording_);
 }
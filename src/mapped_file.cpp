@@ -0,0 +1,71 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wv {
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : addr_(other.addr_), size_(other.size_), valid_(other.valid_) {
+    other.addr_ = nullptr;
+    other.size_ = 0;
+    other.valid_ = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        addr_ = other.addr_;
+        size_ = other.size_;
+        valid_ = other.valid_;
+        other.addr_ = nullptr;
+        other.size_ = 0;
+        other.valid_ = false;
+    }
+    return *this;
+}
+
+MappedFile MappedFile::Open(const std::string& path) {
+    MappedFile file;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return file;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return file;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        ::close(fd);
+        file.valid_ = true;
+        return file;
+    }
+
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) return file;
+
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+    file.addr_ = addr;
+    file.size_ = size;
+    file.valid_ = true;
+    return file;
+}
+
+void MappedFile::reset() {
+    if (addr_) {
+        ::munmap(addr_, size_);
+    }
+    addr_ = nullptr;
+    size_ = 0;
+    valid_ = false;
+}
+
+}
@@ -1,4 +1,5 @@
 #include "pixmap.hpp"
+#include "span_kernels.hpp"
 
 namespace wv {
 
@@ -46,18 +47,21 @@ Pixmap Pixmap::Wrap(const PixmapInfo& info, void* pixels) {
 void Pixmap::clear(Color c) {
     if (!pixels_) return;
 
-    u32 pixel;
-    if (info_.format == PixelFormat::BGRA8888) {
-        pixel = (u32(c.a) << 24) | (u32(c.r) << 16) | (u32(c.g) << 8) | u32(c.b);
-    } else {
-        pixel = (u32(c.a) << 24) | (u32(c.b) << 16) | (u32(c.g) << 8) | u32(c.r);
+    u32 pixel = SpanKernels::PackColor(c, info_.format);
+    const SpanKernels& kernels = SpanKernels::Get();
+    for (i32 y = 0; y < info_.height; ++y) {
+        kernels.fill(static_cast<u32*>(rowAddr(y)), info_.width, pixel);
     }
+}
 
-    u32* p = addr32();
-    i32 count = info_.width * info_.height;
-    for (i32 i = 0; i < count; ++i) {
-        p[i] = pixel;
+void Pixmap::convert(PixelFormat format) {
+    if (!pixels_ || format == info_.format) return;
+    const SpanKernels& kernels = SpanKernels::Get();
+    for (i32 y = 0; y < info_.height; ++y) {
+        u32* row = static_cast<u32*>(rowAddr(y));
+        kernels.swizzle(row, row, info_.width);
     }
+    info_.format = format;
 }
 
 void Pixmap::reset() {
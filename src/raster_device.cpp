@@ -6,7 +6,7 @@
 namespace wv {
 
 SoftwareRasterDevice::SoftwareRasterDevice(Pixmap* target)
-    : target_(target) {
+    : target_(target), kernels_(&SpanKernels::Get()) {
 }
 
 void SoftwareRasterDevice::resize(i32, i32) {
@@ -14,7 +14,7 @@ void SoftwareRasterDevice::resize(i32, i32) {
 }
 
 void SoftwareRasterDevice::beginFrame() {
-    if (target_ && target_->valid()) {
+    if (target_ && target_->valid() && !retainContents_) {
         target_->clear({0, 0, 0, 255});
     }
 }
@@ -28,6 +28,16 @@ Rect SoftwareRasterDevice::effectiveClip() const {
     return {0, 0, f32(target_->width()), f32(target_->height())};
 }
 
+bool SoftwareRasterDevice::drawableArea(i32& x1, i32& y1, i32& x2, i32& y2) const {
+    if (!target_ || !target_->valid()) return false;
+    Rect clip = effectiveClip();
+    x1 = std::max({i32(clip.x), bounds_.x1, 0});
+    y1 = std::max({i32(clip.y), bounds_.y1, 0});
+    x2 = std::min({i32(clip.x + clip.w), bounds_.x2, target_->width()});
+    y2 = std::min({i32(clip.y + clip.h), bounds_.y2, target_->height()});
+    return x1 < x2 && y1 < y2;
+}
+
 bool SoftwareRasterDevice::isClipped(i32 x, i32 y) const {
     Rect clip = effectiveClip();
     return x < i32(clip.x) || x >= i32(clip.x + clip.w) ||
@@ -37,6 +47,7 @@ bool SoftwareRasterDevice::isClipped(i32 x, i32 y) const {
 void SoftwareRasterDevice::blendPixel(i32 x, i32 y, Color c) {
     if (!target_ || !target_->valid()) return;
     if (x < 0 || x >= target_->width() || y < 0 || y >= target_->height()) return;
+    if (x < bounds_.x1 || x >= bounds_.x2 || y < bounds_.y1 || y >= bounds_.y2) return;
     if (isClipped(x, y)) return;
 
     u32* row = static_cast<u32*>(target_->rowAddr(y));
@@ -86,24 +97,41 @@ void SoftwareRasterDevice::drawHLine(i32 x1, i32 x2, i32 y, Color c) {
     if (y < i32(clip.y) || y >= i32(clip.y + clip.h)) return;
     if (x1 > x2) return;
 
-    x1 = std::max(x1, 0);
-    x2 = std::min(x2, target_->width() - 1);
+    if (y < bounds_.y1 || y >= bounds_.y2) return;
+    x1 = std::max({x1, bounds_.x1, 0});
+    x2 = std::min({x2, bounds_.x2 - 1, target_->width() - 1});
+    if (x1 > x2) return;
 
-    u32* row = static_cast<u32*>(target_->rowAddr(y));
-    u32 pixel;
-    if (target_->format() == PixelFormat::BGRA8888) {
-        pixel = (u32(c.a) << 24) | (u32(c.r) << 16) | (u32(c.g) << 8) | u32(c.b);
-    } else {
-        pixel = (u32(c.a) << 24) | (u32(c.b) << 16) | (u32(c.g) << 8) | u32(c.r);
-    }
+    fillSpans(x1, x2 + 1, y, y + 1, c);
+}
 
-    if (c.a == 255) {
-        for (i32 x = x1; x <= x2; ++x) {
-            row[x] = pixel;
+void SoftwareRasterDevice::drawVLine(i32 x, i32 y1, i32 y2, Color c) {
+    i32 minX, minY, maxX, maxY;
+    if (c.a == 0 || !drawableArea(minX, minY, maxX, maxY)) return;
+    if (x < minX || x >= maxX) return;
+    y1 = std::max(y1, minY);
+    y2 = std::min(y2, maxY - 1);
+
+    u32 pixel = SpanKernels::PackColor(c, target_->format());
+    for (i32 y = y1; y <= y2; ++y) {
+        u32* dst = static_cast<u32*>(target_->rowAddr(y)) + x;
+        if (c.a == 255) {
+            *dst = pixel;
+        } else {
+            kernels_->blend(dst, 1, pixel, c.a);
         }
-    } else {
-        for (i32 x = x1; x <= x2; ++x) {
-            blendPixel(x, y, c);
+    }
+}
+
+void SoftwareRasterDevice::fillSpans(i32 x1, i32 x2, i32 y1, i32 y2, Color c) {
+    if (c.a == 0) return;
+    u32 pixel = SpanKernels::PackColor(c, target_->format());
+    for (i32 y = y1; y < y2; ++y) {
+        u32* row = static_cast<u32*>(target_->rowAddr(y)) + x1;
+        if (c.a == 255) {
+            kernels_->fill(row, x2 - x1, pixel);
+        } else {
+            kernels_->blend(row, x2 - x1, pixel, c.a);
         }
     }
 }
@@ -117,16 +145,14 @@ void SoftwareRasterDevice::fillRect(Rect r, Color c) {
     i32 x2 = std::min(i32(r.x + r.w), i32(clip.x + clip.w));
     i32 y2 = std::min(i32(r.y + r.h), i32(clip.y + clip.h));
 
-    x1 = std::max(x1, 0);
-    y1 = std::max(y1, 0);
-    x2 = std::min(x2, target_->width());
-    y2 = std::min(y2, target_->height());
+    x1 = std::max({x1, bounds_.x1, 0});
+    y1 = std::max({y1, bounds_.y1, 0});
+    x2 = std::min({x2, bounds_.x2, target_->width()});
+    y2 = std::min({y2, bounds_.y2, target_->height()});
 
     if (x1 >= x2 || y1 >= y2) return;
 
-    for (i32 y = y1; y < y2; ++y) {
-        drawHLine(x1, x2 - 1, y, c);
-    }
+    fillSpans(x1, x2, y1, y2, c);
 }
 
 void SoftwareRasterDevice::strokeRect(Rect r, Color c, f32) {
@@ -139,13 +165,22 @@ void SoftwareRasterDevice::strokeRect(Rect r, Color c, f32) {
 
     drawHLine(x1, x2, y1, c);
     drawHLine(x1, x2, y2, c);
-    for (i32 y = y1; y <= y2; ++y) {
-        blendPixel(x1, y, c);
-        blendPixel(x2, y, c);
-    }
+    drawVLine(x1, y1, y2, c);
+    drawVLine(x2, y1, y2, c);
 }
 
 void SoftwareRasterDevice::drawLineImpl(i32 x1, i32 y1, i32 x2, i32 y2, Color c) {
+    // Axis-aligned lines are runs; Bresenham visits each of their pixels
+    // once, so a run clipped up front writes the same pixels
+    if (y1 == y2) {
+        drawHLine(std::min(x1, x2), std::max(x1, x2), y1, c);
+        return;
+    }
+    if (x1 == x2) {
+        drawVLine(x1, std::min(y1, y2), std::max(y1, y2), c);
+        return;
+    }
+
     // Bresenham's line algorithm
     i32 dx = std::abs(x2 - x1);
     i32 dy = std::abs(y2 - y1);
@@ -173,17 +208,29 @@ void SoftwareRasterDevice::drawLine(Point p1, Point p2, Color c, f32) {
 }
 
 void SoftwareRasterDevice::drawPolyline(const Point* pts, i32 count, Color c, f32) {
+    i32 minX, minY, maxX, maxY;
+    if (!drawableArea(minX, minY, maxX, maxY)) return;
     for (i32 i = 0; i + 1 < count; ++i) {
-        drawLineImpl(i32(pts[i].x), i32(pts[i].y),
-                     i32(pts[i + 1].x), i32(pts[i + 1].y), c);
+        i32 x1 = i32(pts[i].x), y1 = i32(pts[i].y);
+        i32 x2 = i32(pts[i + 1].x), y2 = i32(pts[i + 1].y);
+        // A segment stays within the box of its endpoints; skip the ones
+        // that cannot reach a drawable pixel
+        if (std::max(x1, x2) < minX || std::min(x1, x2) >= maxX ||
+            std::max(y1, y2) < minY || std::min(y1, y2) >= maxY) {
+            continue;
+        }
+        drawLineImpl(x1, y1, x2, y2, c);
     }
 }
 
 void SoftwareRasterDevice::drawText(Point p, std::string_view text, Color c) {
     if (!target_ || !target_->valid() || !glyphCache_) return;
 
+    i32 x1, y1, x2, y2;
+    if (!drawableArea(x1, y1, x2, y2)) return;
+    Rect area = {f32(x1), f32(y1), f32(x2 - x1), f32(y2 - y1)};
     glyphCache_->drawText(target_->addr32(), target_->width(), target_->height(),
-                          i32(p.x), i32(p.y), text, c);
+                          i32(p.x), i32(p.y), text, c, &area);
 }
 
 void SoftwareRasterDevice::setClipRect(Rect r) {
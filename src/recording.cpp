@@ -1,59 +1,313 @@
 #include "recording.hpp"
+#include <algorithm>
 
 namespace wv {
 
-DrawOpArena::DrawOpArena(size_t initialCapacity) {
-    data_.reserve(initialCapacity);
+DrawOpArena::DrawOpArena(RecordingPool* pool) : pool_(pool) {}
+
+DrawOpArena::~DrawOpArena() {
+    reset();
 }
 
-u32 DrawOpArena::allocate(size_t bytes) {
-    u32 offset = static_cast<u32>(data_.size());
-    data_.resize(data_.size() + bytes);
-    return offset;
+DrawOpArena::DrawOpArena(DrawOpArena&& other) noexcept
+    : pool_(other.pool_), head_(other.head_), tail_(other.tail_), used_(other.used_),
+      slots_(std::move(other.slots_)) {
+    other.head_ = other.tail_ = nullptr;
+    other.used_ = 0;
+    other.slots_.clear();
+}
+
+DrawOpArena& DrawOpArena::operator=(DrawOpArena&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool_ = other.pool_;
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(used_, other.used_);
+        slots_.swap(other.slots_);
+    }
+    return *this;
+}
+
+DrawOpArena::Chunk* DrawOpArena::newChunk(size_t size) {
+    Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+    chunk->next = nullptr;
+    chunk->size = size;
+    return chunk;
+}
+
+u32 DrawOpArena::allocate(size_t bytes, size_t align) {
+    size_t at = (used_ + align - 1) & ~(align - 1);
+    if (!tail_ || at + bytes > tail_->size) {
+        // Chunk data is aligned for any type, so a new chunk starts at 0
+        Chunk* chunk = nullptr;
+        if (bytes <= kChunkSize) {
+            chunk = pool_ ? pool_->takeChunk() : nullptr;
+            if (!chunk) {
+                chunk = newChunk(kChunkSize);
+                if (pool_) pool_->countAllocation();
+            }
+        } else {
+            chunk = newChunk(bytes);
+            if (pool_) pool_->countAllocation();
+        }
+        if (tail_) tail_->next = chunk;
+        else head_ = chunk;
+        tail_ = chunk;
+        size_t slotCapacity = slots_.capacity();
+        slots_.push_back(chunk->data());
+        for (size_t extra = kChunkSize; extra < chunk->size; extra += kChunkSize) {
+            slots_.push_back(nullptr);
+        }
+        if (pool_ && slots_.capacity() != slotCapacity) pool_->countAllocation();
+        at = 0;
+    }
+    used_ = at + bytes;
+    // The last chunk's slot is the one after every slot of the chunks before it
+    size_t slot = slots_.size() - ((tail_->size + kChunkSize - 1) >> kChunkShift);
+    return static_cast<u32>((slot << kChunkShift) + at);
 }
 
 u32 DrawOpArena::storeString(std::string_view str) {
-    u32 offset = static_cast<u32>(data_.size());
-    size_t len = str.size();
-    data_.insert(data_.end(), reinterpret_cast<const u8*>(str.data()), 
-                 reinterpret_cast<const u8*>(str.data()) + len);
-    data_.push_back(0);
+    u32 offset = allocate(str.size() + 1);
+    u8* dst = slots_[offset >> kChunkShift] + (offset & (kChunkSize - 1));
+    std::memcpy(dst, str.data(), str.size());
+    dst[str.size()] = 0;
     return offset;
 }
 
 u32 DrawOpArena::storePoints(const Point* pts, i32 count) {
-    // Align to Point's alignment (4 bytes for f32 members)
-    constexpr size_t align = alignof(Point);
-    size_t cur = data_.size();
-    size_t aligned = (cur + align - 1) & ~(align - 1);
-    if (aligned > cur) {
-        data_.resize(aligned, 0);
-    }
-    u32 offset = static_cast<u32>(data_.size());
-    size_t bytes = count * sizeof(Point);
-    data_.insert(data_.end(), reinterpret_cast<const u8*>(pts),
-                 reinterpret_cast<const u8*>(pts) + bytes);
+    size_t bytes = size_t(count) * sizeof(Point);
+    u32 offset = allocate(bytes, alignof(Point));
+    if (bytes > 0) std::memcpy(getPoints(offset), pts, bytes);
     return offset;
 }
 
 const char* DrawOpArena::getString(u32 offset) const {
-    return reinterpret_cast<const char*>(data_.data() + offset);
+    return reinterpret_cast<const char*>(slots_[offset >> kChunkShift] + (offset & (kChunkSize - 1)));
 }
 
 const Point* DrawOpArena::getPoints(u32 offset) const {
-    return reinterpret_cast<const Point*>(data_.data() + offset);
+    return reinterpret_cast<const Point*>(slots_[offset >> kChunkShift] + (offset & (kChunkSize - 1)));
+}
+
+Point* DrawOpArena::getPoints(u32 offset) {
+    return reinterpret_cast<Point*>(slots_[offset >> kChunkShift] + (offset & (kChunkSize - 1)));
 }
 
 void DrawOpArena::reset() {
-    data_.clear();
+    for (Chunk* chunk = head_; chunk;) {
+        Chunk* next = chunk->next;
+        if (pool_ && chunk->size == kChunkSize) pool_->recycleChunk(chunk);
+        else ::operator delete(chunk);
+        chunk = next;
+    }
+    head_ = tail_ = nullptr;
+    used_ = 0;
+    slots_.clear();
+}
+
+Recording::Recording(std::vector<CompactDrawOp> ops, DrawOpArena arena, u64 culledOps)
+    : ops_(std::move(ops)), arena_(std::move(arena)), culledOps_(culledOps) {}
+
+Recording::~Recording() {
+    if (RecordingPool* pool = arena_.pool()) pool->recycle(ops_, arena_);
+}
+
+void* Recording::operator new(size_t size) {
+    return RecordingPool::shared().takeRecordingBlock(size);
+}
+
+void Recording::operator delete(void* p) {
+    RecordingPool::shared().recycleRecordingBlock(p);
+}
+
+RecordingPool::RecordingPool() {
+    buffers_.reserve(kMaxBuffers);
+}
+
+RecordingPool::~RecordingPool() {
+    buffers_.clear();
+    while (chunks_) {
+        DrawOpArena::Chunk* next = chunks_->next;
+        ::operator delete(chunks_);
+        chunks_ = next;
+    }
+    while (blocks_) {
+        Block* next = blocks_->next;
+        ::operator delete(blocks_);
+        blocks_ = next;
+    }
+}
+
+RecordingPool& RecordingPool::shared() {
+    static RecordingPool pool;
+    return pool;
+}
+
+void RecordingPool::acquire(std::vector<CompactDrawOp>& ops, DrawOpArena& arena) {
+    // Outside the lock: resetting the arena recycles its chunks
+    ops.clear();
+    arena.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffers_.empty()) return;
+    // Largest first: buffers in steady use grow to the biggest recording
+    // once, the small ones are left at the back of the pool
+    auto largest = std::max_element(buffers_.begin(), buffers_.end(),
+        [](const Buffers& a, const Buffers& b) { return a.ops.capacity() < b.ops.capacity(); });
+    std::swap(*largest, buffers_.back());
+    ops.swap(buffers_.back().ops);
+    arena.slots_.swap(buffers_.back().arena.slots_);
+    arena.pool_ = this;
+    buffers_.pop_back();
+}
+
+void RecordingPool::recycle(std::vector<CompactDrawOp>& ops, DrawOpArena& arena) {
+    ops.clear();
+    arena.reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffers_.size() >= kMaxBuffers) return;
+    buffers_.emplace_back();
+    buffers_.back().ops.swap(ops);
+    buffers_.back().arena.slots_.swap(arena.slots_);
+}
+
+DrawOpArena::Chunk* RecordingPool::takeChunk() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DrawOpArena::Chunk* chunk = chunks_;
+    if (chunk) {
+        chunks_ = chunk->next;
+        chunk->next = nullptr;
+        chunkCount_--;
+    }
+    return chunk;
+}
+
+void RecordingPool::recycleChunk(DrawOpArena::Chunk* chunk) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (chunkCount_ < kMaxChunks) {
+            chunk->next = chunks_;
+            chunks_ = chunk;
+            chunkCount_++;
+            return;
+        }
+    }
+    ::operator delete(chunk);
+}
+
+void* RecordingPool::takeRecordingBlock(size_t size) {
+    if (size == sizeof(Recording)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Block* block = blocks_) {
+            blocks_ = block->next;
+            blockCount_--;
+            return block;
+        }
+    }
+    countAllocation();
+    return ::operator new(std::max(size, sizeof(Block)));
+}
+
+void RecordingPool::recycleRecordingBlock(void* block) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (blockCount_ < kMaxRecordingBlocks) {
+            Block* b = static_cast<Block*>(block);
+            b->next = blocks_;
+            blocks_ = b;
+            blockCount_++;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
+
+size_t RecordingPool::bufferCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffers_.size();
+}
+
+size_t RecordingPool::chunkCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chunkCount_;
+}
+
+namespace {
+
+// Finite, so that x + w stays a number for unbounded rects
+constexpr f32 kUnbounded = 1e30f;
+constexpr Rect kEverywhere = {-kUnbounded, -kUnbounded, 2 * kUnbounded, 2 * kUnbounded};
+
+// Rasterizers round coordinates; bounds are widened so rounding never
+// reaches a pixel outside them
+constexpr f32 kBoundsMargin = 1.0f;
+
+Rect spanBounds(f32 x0, f32 y0, f32 x1, f32 y1, f32 pad) {
+    f32 left = std::min(x0, x1) - pad, top = std::min(y0, y1) - pad;
+    return {left, top, std::max(x0, x1) + pad - left, std::max(y0, y1) + pad - top};
+}
+
+Rect pointsBounds(const Point* pts, u32 count, f32 pad) {
+    f32 x0 = pts[0].x, y0 = pts[0].y, x1 = x0, y1 = y0;
+    for (u32 i = 1; i < count; ++i) {
+        x0 = std::min(x0, pts[i].x);
+        y0 = std::min(y0, pts[i].y);
+        x1 = std::max(x1, pts[i].x);
+        y1 = std::max(y1, pts[i].y);
+    }
+    return spanBounds(x0, y0, x1, y1, pad);
+}
+
+// Glyphs start at most a bearing left of and above the pen position
+Rect textBounds(Point p) {
+    return {p.x - 2 * kBoundsMargin, p.y - 2 * kBoundsMargin, kUnbounded, kUnbounded};
+}
+
+bool intersects(const Rect& a, const Rect& b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+Rect intersection(const Rect& a, const Rect& b) {
+    f32 x0 = std::max(a.x, b.x);
+    f32 y0 = std::max(a.y, b.y);
+    f32 x1 = std::min(a.x + a.w, b.x + b.w);
+    f32 y1 = std::min(a.y + a.h, b.y + b.h);
+    return {x0, y0, std::max(0.0f, x1 - x0), std::max(0.0f, y1 - y0)};
+}
+
+Rect shifted(Rect r, f32 dx, f32 dy) {
+    r.x += dx;
+    r.y += dy;
+    return r;
 }
 
-Recording::Recording(std::vector<CompactDrawOp> ops, DrawOpArena arena) 
-    : ops_(std::move(ops)), arena_(std::move(arena)) {}
+}
+
+Recorder::Recorder(RecordingPool* pool)
+    : pool_(pool), arena_(pool), viewport_(kEverywhere), active_(kEverywhere) {}
 
 void Recorder::reset() {
     ops_.clear();
     arena_.reset();
+    hasClip_ = false;
+    culledOps_ = 0;
+    updateActive();
+}
+
+void Recorder::setViewport(Rect r) {
+    viewport_ = r;
+    updateActive();
+}
+
+void Recorder::updateActive() {
+    active_ = hasClip_ ? intersection(viewport_, clip_) : viewport_;
+}
+
+bool Recorder::keep(const Rect& bounds) {
+    if (!culling_ || intersects(bounds, active_)) return true;
+    culledOps_++;
+    return false;
 }
 
 void Recorder::fillRect(Rect r, Color c) {
@@ -62,7 +316,8 @@ void Recorder::fillRect(Rect r, Color c) {
     op.color = c;
     op.width = 1.0f;
     op.data.fill.rect = r;
-    ops_.push_back(op);
+    op.bounds = spanBounds(r.x, r.y, r.x + r.w, r.y + r.h, kBoundsMargin);
+    if (keep(op.bounds)) ops_.push_back(op);
 }
 
 void Recorder::strokeRect(Rect r, Color c, f32 width) {
@@ -71,7 +326,8 @@ void Recorder::strokeRect(Rect r, Color c, f32 width) {
     op.color = c;
     op.width = width;
     op.data.stroke.rect = r;
-    ops_.push_back(op);
+    op.bounds = spanBounds(r.x, r.y, r.x + r.w, r.y + r.h, width + kBoundsMargin);
+    if (keep(op.bounds)) ops_.push_back(op);
 }
 
 void Recorder::drawLine(Point p1, Point p2, Color c, f32 width) {
@@ -81,7 +337,8 @@ void Recorder::drawLine(Point p1, Point p2, Color c, f32 width) {
     op.width = width;
     op.data.line.p1 = p1;
     op.data.line.p2 = p2;
-    ops_.push_back(op);
+    op.bounds = spanBounds(p1.x, p1.y, p2.x, p2.y, width + kBoundsMargin);
+    if (keep(op.bounds)) ops_.push_back(op);
 }
 
 void Recorder::drawPolyline(const Point* pts, i32 count, Color c, f32 width) {
@@ -90,6 +347,8 @@ void Recorder::drawPolyline(const Point* pts, i32 count, Color c, f32 width) {
     op.type = DrawOp::Type::Polyline;
     op.color = c;
     op.width = width;
+    op.bounds = pointsBounds(pts, u32(count), width + kBoundsMargin);
+    if (!keep(op.bounds)) return;
     op.data.polyline.offset = arena_.storePoints(pts, count);
     op.data.polyline.count = static_cast<u32>(count);
     ops_.push_back(op);
@@ -100,6 +359,8 @@ void Recorder::drawText(Point p, std::string_view text, Color c) {
     op.type = DrawOp::Type::Text;
     op.color = c;
     op.width = 1.0f;
+    op.bounds = textBounds(p);
+    if (!keep(op.bounds)) return;
     op.data.text.pos = p;
     op.data.text.offset = arena_.storeString(text);
     op.data.text.len = static_cast<u32>(text.size());
@@ -112,7 +373,11 @@ void Recorder::setClip(Rect r) {
     op.color = {};
     op.width = 1.0f;
     op.data.clip.rect = r;
+    op.bounds = kEverywhere;
     ops_.push_back(op);
+    hasClip_ = true;
+    clip_ = r;
+    updateActive();
 }
 
 void Recorder::clearClip() {
@@ -120,13 +385,91 @@ void Recorder::clearClip() {
     op.type = DrawOp::Type::ClearClip;
     op.color = {};
     op.width = 1.0f;
+    op.bounds = kEverywhere;
     ops_.push_back(op);
+    hasClip_ = false;
+    updateActive();
+}
+
+void Recorder::append(const Recording& recording, Point offset) {
+    const f32 dx = offset.x, dy = offset.y;
+    const auto& arena = recording.arena();
+    // The appended clips nest inside the one active here: a SetClip is
+    // narrowed to it and a ClearClip goes back to it
+    const bool outerClip = hasClip_;
+    const Rect outer = clip_;
+    ops_.reserve(ops_.size() + recording.ops().size());
+    for (CompactDrawOp op : recording.ops()) {
+        switch (op.type) {
+            case DrawOp::Type::SetClip:
+                op.data.clip.rect = shifted(op.data.clip.rect, dx, dy);
+                if (outerClip) op.data.clip.rect = intersection(op.data.clip.rect, outer);
+                hasClip_ = true;
+                clip_ = op.data.clip.rect;
+                updateActive();
+                break;
+            case DrawOp::Type::ClearClip:
+                if (outerClip) {
+                    op.type = DrawOp::Type::SetClip;
+                    op.data.clip.rect = outer;
+                }
+                hasClip_ = outerClip;
+                clip_ = outer;
+                updateActive();
+                break;
+            default:
+                // Culled before any arena data is copied
+                op.bounds = shifted(op.bounds, dx, dy);
+                if (!keep(op.bounds)) continue;
+                break;
+        }
+        switch (op.type) {
+            case DrawOp::Type::FillRect:
+            case DrawOp::Type::StrokeRect:
+                // fill and stroke share the Rect layout
+                op.data.fill.rect.x += dx;
+                op.data.fill.rect.y += dy;
+                break;
+            case DrawOp::Type::Line:
+                op.data.line.p1.x += dx;
+                op.data.line.p1.y += dy;
+                op.data.line.p2.x += dx;
+                op.data.line.p2.y += dy;
+                break;
+            case DrawOp::Type::Polyline: {
+                u32 count = op.data.polyline.count;
+                u32 dst = arena_.storePoints(arena.getPoints(op.data.polyline.offset), i32(count));
+                Point* pts = arena_.getPoints(dst);
+                for (u32 i = 0; i < count; ++i) {
+                    pts[i].x += dx;
+                    pts[i].y += dy;
+                }
+                op.data.polyline.offset = dst;
+                break;
+            }
+            case DrawOp::Type::Text:
+                op.data.text.pos.x += dx;
+                op.data.text.pos.y += dy;
+                op.data.text.offset = arena_.storeString(
+                    std::string_view(arena.getString(op.data.text.offset), op.data.text.len));
+                break;
+            case DrawOp::Type::SetClip:
+            case DrawOp::Type::ClearClip:
+                break;
+        }
+        ops_.push_back(op);
+    }
 }
 
 std::unique_ptr<Recording> Recorder::finish() {
-    auto recording = std::make_unique<Recording>(std::move(ops_), std::move(arena_));
+    if (pool_ && ops_.capacity() != opsCapacity_) pool_->countAllocation();
+    auto recording = std::make_unique<Recording>(std::move(ops_), std::move(arena_), culledOps_);
     ops_.clear();
-    arena_.reset();
+    hasClip_ = false;
+    culledOps_ = 0;
+    updateActive();
+    if (pool_) pool_->acquire(ops_, arena_);
+    opsCapacity_ = ops_.capacity();
     return recording;
 }
 
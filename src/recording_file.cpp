@@ -0,0 +1,187 @@
+#include "recording_file.hpp"
+#include "mapped_file.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace wv {
+
+namespace {
+
+constexpr char kMagic[4] = {'W', 'V', 'R', '1'};
+constexpr u32 kVersion = 1;
+
+struct FileHeader {
+    char magic[4];
+    u32 version;
+    u64 frameCount;
+};
+
+struct FrameHeader {
+    i32 width;
+    i32 height;
+    u64 opCount;
+    u64 payloadBytes;
+};
+
+// CompactDrawOp with a fixed-width type; polyline and text offsets point
+// into the frame's payload
+struct FileOp {
+    u8 type;
+    u8 pad[3];
+    Color color;
+    f32 width;
+    u8 data[16];
+};
+
+static_assert(sizeof(FileHeader) == 16, "recording file header layout");
+static_assert(sizeof(FrameHeader) == 24, "recording frame header layout");
+static_assert(sizeof(FileOp) == 28, "recording op layout");
+static_assert(sizeof(CompactDrawOp::Data) == sizeof(FileOp::data), "recording op data layout");
+
+constexpr u8 kLastType = u8(DrawOp::Type::ClearClip);
+
+void appendBytes(std::vector<u8>& out, const void* src, size_t bytes) {
+    const u8* p = static_cast<const u8*>(src);
+    out.insert(out.end(), p, p + bytes);
+}
+
+}
+
+bool RecordingFile::Write(const std::string& path, const std::vector<RecordingFrame>& frames) {
+    std::string tmpPath = path + ".tmp";
+    std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!f) return false;
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.frameCount = frames.size();
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<FileOp> ops;
+    std::vector<u8> payload;
+    for (const RecordingFrame& frame : frames) {
+        ops.clear();
+        payload.clear();
+        if (frame.recording) {
+            const DrawOpArena& arena = frame.recording->arena();
+            for (const CompactDrawOp& op : frame.recording->ops()) {
+                FileOp out = {};
+                out.type = u8(op.type);
+                out.color = op.color;
+                out.width = op.width;
+                CompactDrawOp::Data data = op.data;
+                if (op.type == DrawOp::Type::Polyline) {
+                    data.polyline.offset = u32(payload.size());
+                    appendBytes(payload, arena.getPoints(op.data.polyline.offset),
+                                op.data.polyline.count * sizeof(Point));
+                } else if (op.type == DrawOp::Type::Text) {
+                    data.text.offset = u32(payload.size());
+                    appendBytes(payload, arena.getString(op.data.text.offset), op.data.text.len);
+                }
+                std::memcpy(out.data, &data, sizeof(out.data));
+                ops.push_back(out);
+            }
+        }
+
+        FrameHeader fh = {};
+        fh.width = frame.width;
+        fh.height = frame.height;
+        fh.opCount = ops.size();
+        fh.payloadBytes = payload.size();
+        f.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+        f.write(reinterpret_cast<const char*>(ops.data()), std::streamsize(ops.size() * sizeof(FileOp)));
+        f.write(reinterpret_cast<const char*>(payload.data()), std::streamsize(payload.size()));
+    }
+
+    f.close();
+    if (!f) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RecordingFile::Read(const std::string& path, std::vector<RecordingFrame>& frames) {
+    MappedFile file = MappedFile::Open(path);
+    if (!file.valid() || file.size() < sizeof(FileHeader)) return false;
+
+    FileHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+
+    const u8* p = reinterpret_cast<const u8*>(file.data()) + sizeof(header);
+    const u8* end = reinterpret_cast<const u8*>(file.data()) + file.size();
+    std::vector<RecordingFrame> result;
+    std::vector<Point> points;
+    for (u64 i = 0; i < header.frameCount; ++i) {
+        FrameHeader fh;
+        if (size_t(end - p) < sizeof(fh)) return false;
+        std::memcpy(&fh, p, sizeof(fh));
+        p += sizeof(fh);
+        if (fh.opCount > size_t(end - p) / sizeof(FileOp) ||
+            fh.payloadBytes > size_t(end - p) - fh.opCount * sizeof(FileOp)) return false;
+        const u8* payload = p + fh.opCount * sizeof(FileOp);
+
+        // Rebuilt through a Recorder, so the arena is laid out as if recorded here
+        Recorder recorder;
+        for (u64 k = 0; k < fh.opCount; ++k) {
+            FileOp in;
+            std::memcpy(&in, p + k * sizeof(FileOp), sizeof(in));
+            if (in.type > kLastType) return false;
+            CompactDrawOp::Data data;
+            std::memcpy(&data, in.data, sizeof(data));
+            switch (DrawOp::Type(in.type)) {
+                case DrawOp::Type::FillRect:
+                    recorder.fillRect(data.fill.rect, in.color);
+                    break;
+                case DrawOp::Type::StrokeRect:
+                    recorder.strokeRect(data.stroke.rect, in.color, in.width);
+                    break;
+                case DrawOp::Type::Line:
+                    recorder.drawLine(data.line.p1, data.line.p2, in.color, in.width);
+                    break;
+                case DrawOp::Type::Polyline: {
+                    u64 bytes = u64(data.polyline.count) * sizeof(Point);
+                    if (data.polyline.offset > fh.payloadBytes ||
+                        bytes > fh.payloadBytes - data.polyline.offset) return false;
+                    points.resize(data.polyline.count);
+                    std::memcpy(points.data(), payload + data.polyline.offset, bytes);
+                    recorder.drawPolyline(points.data(), i32(points.size()), in.color, in.width);
+                    break;
+                }
+                case DrawOp::Type::Text:
+                    if (data.text.offset > fh.payloadBytes ||
+                        data.text.len > fh.payloadBytes - data.text.offset) return false;
+                    recorder.drawText(data.text.pos,
+                        std::string_view(reinterpret_cast<const char*>(payload) + data.text.offset,
+                                         data.text.len), in.color);
+                    break;
+                case DrawOp::Type::SetClip:
+                    recorder.setClip(data.clip.rect);
+                    break;
+                case DrawOp::Type::ClearClip:
+                    recorder.clearClip();
+                    break;
+            }
+        }
+        p = payload + fh.payloadBytes;
+
+        RecordingFrame frame;
+        frame.width = fh.width;
+        frame.height = fh.height;
+        frame.recording = recorder.finish();
+        result.push_back(std::move(frame));
+    }
+    if (p != end) return false;
+
+    frames = std::move(result);
+    return true;
+}
+
+}
@@ -0,0 +1,217 @@
+#include "span_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WV_SPAN_X86 1
+#include <immintrin.h>
+#else
+#define WV_SPAN_X86 0
+#endif
+
+namespace wv {
+
+namespace {
+
+// x / 255 rounded down, exact for x in [0, 255 * 255]
+inline u32 div255(u32 x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+void fillScalar(u32* dst, i32 count, u32 pixel) {
+    for (i32 i = 0; i < count; ++i) dst[i] = pixel;
+}
+
+void blendScalar(u32* dst, i32 count, u32 pixel, u8 alpha) {
+    const u32 a = alpha, inv = 255 - alpha;
+    const u32 s0 = (pixel & 0xFF) * a;
+    const u32 s1 = ((pixel >> 8) & 0xFF) * a;
+    const u32 s2 = ((pixel >> 16) & 0xFF) * a;
+    for (i32 i = 0; i < count; ++i) {
+        u32 d = dst[i];
+        dst[i] = 0xFF000000 |
+                 (div255(s2 + ((d >> 16) & 0xFF) * inv) << 16) |
+                 (div255(s1 + ((d >> 8) & 0xFF) * inv) << 8) |
+                 div255(s0 + (d & 0xFF) * inv);
+    }
+}
+
+void swizzleScalar(u32* dst, const u32* src, i32 count) {
+    for (i32 i = 0; i < count; ++i) {
+        u32 p = src[i];
+        dst[i] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+    }
+}
+
+#if WV_SPAN_X86
+
+// Target attributes let one file hold every instruction set; callers reach
+// them only through ForIsa, after checking the CPU
+
+__attribute__((target("sse2")))
+void fillSse2(u32* dst, i32 count, u32 pixel) {
+    const __m128i v = _mm_set1_epi32(i32(pixel));
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    for (; i < count; ++i) dst[i] = pixel;
+}
+
+// Blends the 8 channels of two pixels held as 16-bit lanes
+__attribute__((target("sse2")))
+inline __m128i blendLanes(__m128i d, __m128i src, __m128i inv) {
+    __m128i x = _mm_add_epi16(src, _mm_mullo_epi16(d, inv));
+    // div255: (x + 1 + (x >> 8)) >> 8, no lane exceeds 16 bits
+    x = _mm_add_epi16(x, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(x, 8)));
+    return _mm_srli_epi16(x, 8);
+}
+
+__attribute__((target("sse2")))
+void blendSse2(u32* dst, i32 count, u32 pixel, u8 alpha) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(i32(0xFF000000));
+    // src * alpha and 255 - alpha per 16-bit channel lane
+    const __m128i src = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set1_epi32(i32(pixel)), zero),
+                                        _mm_set1_epi16(alpha));
+    const __m128i inv = _mm_set1_epi16(short(255 - alpha));
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = blendLanes(_mm_unpacklo_epi8(d, zero), src, inv);
+        __m128i hi = blendLanes(_mm_unpackhi_epi8(d, zero), src, inv);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+    blendScalar(dst + i, count - i, pixel, alpha);
+}
+
+__attribute__((target("sse2")))
+void swizzleSse2(u32* dst, const u32* src, i32 count) {
+    const __m128i keep = _mm_set1_epi32(i32(0xFF00FF00));
+    const __m128i low = _mm_set1_epi32(0xFF);
+    i32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i out = _mm_or_si128(_mm_and_si128(p, keep),
+                      _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), low),
+                                   _mm_slli_epi32(_mm_and_si128(p, low), 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+    swizzleScalar(dst + i, src + i, count - i);
+}
+
+// AVX2 kernels finish with masked 8-pixel steps rather than calling the
+// SSE2 or scalar versions, which would mix legacy SSE and AVX code
+
+// Lanes [0, count) of 8 set, for masked loads and stores
+__attribute__((target("avx2")))
+inline __m256i tailMask(i32 count) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+__attribute__((target("avx2")))
+void fillAvx2(u32* dst, i32 count, u32 pixel) {
+    const __m256i v = _mm256_set1_epi32(i32(pixel));
+    i32 i = 0;
+    for (; i + 8 <= count; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    if (i < count) _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), tailMask(count - i), v);
+}
+
+__attribute__((target("avx2")))
+inline __m256i blend8(__m256i d, __m256i src, __m256i inv) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    // Unpack and pack both work within 128-bit halves, so pixel order holds
+    __m256i lo = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv));
+    __m256i hi = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_add_epi16(one, _mm256_srli_epi16(lo, 8))), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_add_epi16(one, _mm256_srli_epi16(hi, 8))), 8);
+    return _mm256_or_si256(_mm256_packus_epi16(lo, hi), _mm256_set1_epi32(i32(0xFF000000)));
+}
+
+__attribute__((target("avx2")))
+void blendAvx2(u32* dst, i32 count, u32 pixel, u8 alpha) {
+    const __m256i src = _mm256_mullo_epi16(
+        _mm256_unpacklo_epi8(_mm256_set1_epi32(i32(pixel)), _mm256_setzero_si256()),
+        _mm256_set1_epi16(alpha));
+    const __m256i inv = _mm256_set1_epi16(short(255 - alpha));
+    i32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i* p = reinterpret_cast<__m256i*>(dst + i);
+        _mm256_storeu_si256(p, blend8(_mm256_loadu_si256(p), src, inv));
+    }
+    if (i < count) {
+        __m256i mask = tailMask(count - i);
+        int* p = reinterpret_cast<int*>(dst + i);
+        _mm256_maskstore_epi32(p, mask, blend8(_mm256_maskload_epi32(p, mask), src, inv));
+    }
+}
+
+__attribute__((target("avx2")))
+void swizzleAvx2(u32* dst, const u32* src, i32 count) {
+    const __m256i order = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                           2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    i32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(p, order));
+    }
+    if (i < count) {
+        __m256i mask = tailMask(count - i);
+        __m256i p = _mm256_maskload_epi32(reinterpret_cast<const int*>(src + i), mask);
+        _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), mask, _mm256_shuffle_epi8(p, order));
+    }
+}
+
+#endif
+
+const SpanKernels kScalar = {fillScalar, blendScalar, swizzleScalar};
+#if WV_SPAN_X86
+const SpanKernels kSse2 = {fillSse2, blendSse2, swizzleSse2};
+const SpanKernels kAvx2 = {fillAvx2, blendAvx2, swizzleAvx2};
+#endif
+
+bool supported(SpanIsa isa) {
+#if WV_SPAN_X86
+    switch (isa) {
+        case SpanIsa::Scalar: return true;
+        case SpanIsa::SSE2: return __builtin_cpu_supports("sse2");
+        case SpanIsa::AVX2: return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return isa == SpanIsa::Scalar;
+#endif
+}
+
+}
+
+SpanIsa SpanKernels::BestIsa() {
+    static const SpanIsa best = supported(SpanIsa::AVX2) ? SpanIsa::AVX2
+                              : supported(SpanIsa::SSE2) ? SpanIsa::SSE2
+                              : SpanIsa::Scalar;
+    return best;
+}
+
+const SpanKernels& SpanKernels::ForIsa(SpanIsa isa) {
+#if WV_SPAN_X86
+    if (isa == SpanIsa::AVX2 && supported(SpanIsa::AVX2)) return kAvx2;
+    if (isa != SpanIsa::Scalar && supported(SpanIsa::SSE2)) return kSse2;
+#else
+    (void)isa;
+#endif
+    return kScalar;
+}
+
+const SpanKernels& SpanKernels::Get() {
+    static const SpanKernels& kernels = ForIsa(BestIsa());
+    return kernels;
+}
+
+const char* SpanKernels::IsaName(SpanIsa isa) {
+    switch (isa) {
+        case SpanIsa::Scalar: return "scalar";
+        case SpanIsa::SSE2: return "sse2";
+        case SpanIsa::AVX2: return "avx2";
+    }
+    return "?";
+}
+
+}
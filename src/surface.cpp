@@ -2,6 +2,8 @@
 #include "canvas.hpp"
 #include "context.hpp"
 #include "device.hpp"
+#include "raster_device.hpp"
+#include <cmath>
 
 namespace wv {
 
@@ -38,12 +40,69 @@ void Surface::endFrame() {
 }
 
 void Surface::submit(const Recording& recording) {
+    submit(recording, nullptr);
+}
+
+void Surface::submit(const Recording& recording, const Rect& area) {
+    submit(recording, &area);
+}
+
+void Surface::submit(const Recording& recording, const Rect* area) {
+    DrawPass pass;
+    bool sorted = drawPass_ && recording.ops().size() >= drawPassMinOps_;
+    if (sorted) pass = DrawPass::create(recording, &sortScratch_, glyphCache_);
+    const std::vector<u32>* order = sorted ? &pass.sortedIndices() : nullptr;
+    
+    if (collectSubmitStats_) {
+        PassStats recorded = DrawPass::measure(recording, nullptr);
+        PassStats submitted = sorted ? DrawPass::measure(recording, order) : recorded;
+        submitStats_.recordings++;
+        submitStats_.sortedRecordings += sorted ? 1 : 0;
+        submitStats_.ops += recording.ops().size();
+        submitStats_.recorded.stateSwitches += recorded.stateSwitches;
+        submitStats_.recorded.flushes += recorded.flushes;
+        submitStats_.submitted.stateSwitches += submitted.stateSwitches;
+        submitStats_.submitted.flushes += submitted.flushes;
+    }
+    
     if (context_) {
-        context_->submit(recording);
+        context_->submit(recording, order);
+        return;
+    }
+    if (area && raster_) {
+        raster_->setBounds(i32(std::floor(area->x)), i32(std::floor(area->y)),
+                           i32(std::ceil(area->x + area->w)), i32(std::ceil(area->y + area->h)));
+        replay(recording, order);
+        raster_->resetBounds();
+        return;
+    }
+    if (tiled_ && raster_) {
+        tiled_->replay(recording, order, *raster_);
         return;
     }
+    replay(recording, order);
+}
+
+void Surface::setRetainContents(bool retain) {
+    if (raster_) raster_->setRetainContents(retain);
+}
+
+bool Surface::retainContents() const {
+    return raster_ && raster_->retainContents();
+}
+
+void Surface::setRasterThreads(i32 threads, i32 tileWidth, i32 tileHeight) {
+    tiled_.reset();
+    if (threads != 1) tiled_ = std::make_unique<TiledRaster>(threads, tileWidth, tileHeight);
+    if (tiled_ && tiled_->threads() == 1) tiled_.reset();
+}
+
+void Surface::replay(const Recording& recording, const std::vector<u32>* order) {
     const auto& arena = recording.arena();
-    for (const auto& op : recording.ops()) {
+    const auto& ops = recording.ops();
+    size_t count = order ? order->size() : ops.size();
+    for (size_t i = 0; i < count; ++i) {
+        const auto& op = ops[order ? (*order)[i] : i];
         switch (op.type) {
             case DrawOp::Type::FillRect:
                 device_->fillRect(op.data.fill.rect, op.color);
@@ -77,7 +136,7 @@ void Surface::flush() {
     if (context_) {
         auto recording = device_->finishRecording();
         if (recording) {
-            context_->submit(*recording);
+            submit(*recording);
         }
         context_->flush();
     }
@@ -97,6 +156,7 @@ std::unique_ptr<Recording> Surface::takeRecording() {
 }
 
 void Surface::setGlyphCache(GlyphCache* cache) {
+    glyphCache_ = cache;
     if (context_) {
         context_->setGlyphCache(cache);
     }
@@ -8,7 +8,10 @@ std::unique_ptr<Surface> Surface::MakeRaster(i32 w, i32 h, PixelFormat fmt) {
     if (!pixmap->valid()) return nullptr;
 
     auto device = std::make_unique<SoftwareRasterDevice>(pixmap.get());
-    return std::unique_ptr<Surface>(new Surface(std::move(device), nullptr, std::move(pixmap)));
+    SoftwareRasterDevice* raster = device.get();
+    std::unique_ptr<Surface> surface(new Surface(std::move(device), nullptr, std::move(pixmap)));
+    surface->raster_ = raster;
+    return surface;
 }
 
 std::unique_ptr<Surface> Surface::MakeRasterDirect(const PixmapInfo& info, void* pixels) {
@@ -16,7 +19,10 @@ std::unique_ptr<Surface> Surface::MakeRasterDirect(const PixmapInfo& info, void*
     if (!pixmap->valid()) return nullptr;
 
     auto device = std::make_unique<SoftwareRasterDevice>(pixmap.get());
-    return std::unique_ptr<Surface>(new Surface(std::move(device), nullptr, std::move(pixmap)));
+    SoftwareRasterDevice* raster = device.get();
+    std::unique_ptr<Surface> surface(new Surface(std::move(device), nullptr, std::move(pixmap)));
+    surface->raster_ = raster;
+    return surface;
 }
 
 }
@@ -0,0 +1,64 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace wv {
+
+ThreadPool::ThreadPool(i32 threads) {
+    if (threads <= 0) threads = i32(std::max(1u, std::thread::hardware_concurrency()));
+    for (i32 w = 1; w < threads; ++w) {
+        threads_.emplace_back([this, w]() { workerLoop(w); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, i32)>& fn) {
+    if (threads_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) fn(i, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        count_ = count;
+        next_ = 0;
+        active_ = i32(threads_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return active_ == 0; });
+    job_ = nullptr;
+}
+
+void ThreadPool::workerLoop(i32 worker) {
+    u64 seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        run(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) done_.notify_one();
+    }
+}
+
+void ThreadPool::run(i32 worker) {
+    for (size_t i = next_++; i < count_; i = next_++) {
+        (*job_)(i, worker);
+    }
+}
+
+}
@@ -0,0 +1,162 @@
+#include "tiled_raster.hpp"
+#include "raster_device.hpp"
+#include "glyph_cache.hpp"
+#include <algorithm>
+
+namespace wv {
+
+namespace {
+
+// First pixel at or after v, clamped to [0, limit]
+i32 firstPixel(f32 v, i32 limit) {
+    return i32(std::clamp(v, 0.0f, f32(limit)));
+}
+
+// One past the last pixel an op ending at v can touch. Rasterizers truncate
+// coordinates, so that is the pixel containing v itself.
+i32 endPixel(f32 v, i32 limit) {
+    if (v < 0) return 0;
+    return std::min(limit, i32(std::min(v, f32(limit))) + 1);
+}
+
+void drawOp(SoftwareRasterDevice& device, const CompactDrawOp& op, const DrawOpArena& arena) {
+    switch (op.type) {
+        case DrawOp::Type::FillRect:
+            device.fillRect(op.data.fill.rect, op.color);
+            break;
+        case DrawOp::Type::StrokeRect:
+            device.strokeRect(op.data.stroke.rect, op.color, op.width);
+            break;
+        case DrawOp::Type::Line:
+            device.drawLine(op.data.line.p1, op.data.line.p2, op.color, op.width);
+            break;
+        case DrawOp::Type::Polyline:
+            device.drawPolyline(arena.getPoints(op.data.polyline.offset),
+                                i32(op.data.polyline.count), op.color, op.width);
+            break;
+        case DrawOp::Type::Text:
+            device.drawText(op.data.text.pos,
+                            std::string_view(arena.getString(op.data.text.offset), op.data.text.len),
+                            op.color);
+            break;
+        case DrawOp::Type::SetClip:
+        case DrawOp::Type::ClearClip:
+            break;
+    }
+}
+
+}
+
+TiledRaster::TiledRaster(i32 threads, i32 tileWidth, i32 tileHeight)
+    : pool_(threads), tileWidth_(std::max(1, tileWidth)), tileHeight_(std::max(1, tileHeight)) {
+}
+
+void TiledRaster::replay(const Recording& recording, const std::vector<u32>* order,
+                         SoftwareRasterDevice& device) {
+    Pixmap* target = device.target();
+    if (!target || !target->valid()) return;
+    GlyphCache* glyphs = device.glyphCache();
+    const i32 width = target->width(), height = target->height();
+    const i32 cols = (width + tileWidth_ - 1) / tileWidth_;
+    const i32 rows = (height + tileHeight_ - 1) / tileHeight_;
+
+    if (bins_.size() < size_t(cols) * rows) bins_.resize(size_t(cols) * rows);
+    for (auto& bin : bins_) bin.clear();
+    clips_.clear();
+
+    u32 clip = kNoClip;
+    if (const Rect* start = device.clipRect()) {
+        clips_.push_back(*start);
+        clip = 0;
+    }
+
+    const auto& ops = recording.ops();
+    const auto& arena = recording.arena();
+    size_t count = order ? order->size() : ops.size();
+    for (size_t i = 0; i < count; ++i) {
+        u32 index = order ? (*order)[i] : u32(i);
+        const CompactDrawOp& op = ops[index];
+        Rect bounds = op.bounds;
+        switch (op.type) {
+            case DrawOp::Type::SetClip:
+                clips_.push_back(op.data.clip.rect);
+                clip = u32(clips_.size() - 1);
+                continue;
+            case DrawOp::Type::ClearClip:
+                clip = kNoClip;
+                continue;
+            case DrawOp::Type::Polyline:
+                if (op.data.polyline.count == 0) continue;
+                break;
+            case DrawOp::Type::Text: {
+                // Recorded text bounds are open-ended; the glyphs give the
+                // real extent, and warming them here keeps tiles read-only
+                if (!glyphs) continue;
+                Point p = op.data.text.pos;
+                bounds = glyphs->textBounds(i32(p.x), i32(p.y),
+                    std::string_view(arena.getString(op.data.text.offset), op.data.text.len));
+                if (bounds.w <= 0 || bounds.h <= 0) continue;
+                break;
+            }
+            default:
+                break;
+        }
+
+        i32 x1 = firstPixel(bounds.x, width), x2 = endPixel(bounds.x + bounds.w, width);
+        i32 y1 = firstPixel(bounds.y, height), y2 = endPixel(bounds.y + bounds.h, height);
+        if (clip != kNoClip) {
+            // Same rounding as SoftwareRasterDevice's clip test
+            const Rect& c = clips_[clip];
+            x1 = std::max(x1, i32(std::clamp(c.x, -1.0f, f32(width))));
+            y1 = std::max(y1, i32(std::clamp(c.y, -1.0f, f32(height))));
+            x2 = std::min(x2, i32(std::clamp(c.x + c.w, -1.0f, f32(width))));
+            y2 = std::min(y2, i32(std::clamp(c.y + c.h, -1.0f, f32(height))));
+        }
+        if (x1 >= x2 || y1 >= y2) continue;
+
+        for (i32 ty = y1 / tileHeight_; ty <= (y2 - 1) / tileHeight_; ++ty) {
+            for (i32 tx = x1 / tileWidth_; tx <= (x2 - 1) / tileWidth_; ++tx) {
+                bins_[size_t(ty) * cols + tx].push_back({index, clip});
+            }
+        }
+    }
+
+    tiles_.clear();
+    for (u32 t = 0; t < u32(cols * rows); ++t) {
+        if (!bins_[t].empty()) tiles_.push_back(t);
+    }
+    // Busiest tiles first so that no worker picks up a heavy one last
+    std::sort(tiles_.begin(), tiles_.end(), [this](u32 a, u32 b) {
+        return bins_[a].size() > bins_[b].size();
+    });
+
+    const SpanKernels& kernels = device.spanKernels();
+    pool_.parallelFor(tiles_.size(), [&](size_t i, i32) {
+        u32 t = tiles_[i];
+        i32 x = i32(t % u32(cols)) * tileWidth_, y = i32(t / u32(cols)) * tileHeight_;
+        SoftwareRasterDevice tile(target);
+        tile.setGlyphCache(glyphs);
+        tile.setSpanKernels(kernels);
+        tile.setBounds(x, y, std::min(x + tileWidth_, width), std::min(y + tileHeight_, height));
+        u32 current = kNoClip;
+        for (const Entry& e : bins_[t]) {
+            if (e.clip != current) {
+                current = e.clip;
+                if (current == kNoClip) {
+                    tile.resetClip();
+                } else {
+                    tile.setClipRect(clips_[current]);
+                }
+            }
+            drawOp(tile, ops[e.op], arena);
+        }
+    });
+
+    if (clip == kNoClip) {
+        device.resetClip();
+    } else {
+        device.setClipRect(clips_[clip]);
+    }
+}
+
+}
@@ -1,148 +1,641 @@
 #include "vcd_parser.hpp"
+#include "mapped_file.hpp"
+#include "waveform_cache.hpp"
 #include <fstream>
-#include <sstream>
 #include <algorithm>
+#include <charconv>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <thread>
 
 namespace wv {
 
-bool VcdParser::parse(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) return false;
-    
-    data_ = WaveformData{};
-    signalIndex_.clear();
-    parseHeader(file);
-    parseValues(file);
-    return true;
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
 }
 
-std::string VcdParser::trim(const std::string& s) {
+// Whitespace-separated tokens of one line, matching istream >> std::string.
+struct LineTokens {
+    std::string_view rest;
+
+    std::string_view next() {
+        size_t i = 0;
+        while (i < rest.size() && isSpace(rest[i])) i++;
+        size_t start = i;
+        while (i < rest.size() && !isSpace(rest[i])) i++;
+        std::string_view token = rest.substr(start, i - start);
+        rest.remove_prefix(i);
+        return token;
+    }
+};
+
+std::string_view trimSpace(std::string_view s) {
     size_t start = s.find_first_not_of(" \t\r\n");
-    if (start == std::string::npos) return "";
+    if (start == std::string_view::npos) return {};
     size_t end = s.find_last_not_of(" \t\r\n");
     return s.substr(start, end - start + 1);
 }
 
-bool VcdParser::parseTimescaleParts(const std::string& value, const std::string& unit) {
-    if (value.empty() || unit.empty()) return false;
-    
-    i32 val = 0;
-    try {
-        val = std::stoi(value);
-    } catch (...) {
-        return false;
-    }
-    
-    u64 mult = 1;
-    if (unit.find("ps") != std::string::npos) mult = 1;
-    else if (unit.find("ns") != std::string::npos) mult = 1000;
-    else if (unit.find("us") != std::string::npos) mult = 1000000;
-    else if (unit.find("ms") != std::string::npos) mult = 1000000000;
-    else return false;
-    
-    data_.timescale = u64(val) * mult;
+// Splits [p, end) into lines the way std::getline does: a trailing '\n'
+// does not produce an extra empty line.
+bool nextLine(const char*& p, const char* end, std::string_view& line) {
+    if (p >= end) return false;
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    const char* lineEnd = nl ? nl : end;
+    line = std::string_view(p, size_t(lineEnd - p));
+    p = nl ? nl + 1 : end;
     return true;
 }
 
-bool VcdParser::parseTimescaleToken(const std::string& token) {
-    size_t pos = 0;
-    while (pos < token.size() && std::isdigit(static_cast<unsigned char>(token[pos]))) pos++;
-    if (pos == 0 || pos == token.size()) return false;
-    
-    std::string value = token.substr(0, pos);
-    std::string unit = token.substr(pos);
-    return parseTimescaleParts(value, unit);
+// Unsigned decimal prefix after optional leading whitespace (std::stoull semantics).
+bool parseU64(std::string_view s, u64& out) {
+    size_t i = 0;
+    while (i < s.size() && isSpace(s[i])) i++;
+    if (i < s.size() && s[i] == '+') i++;
+    auto [ptr, ec] = std::from_chars(s.data() + i, s.data() + s.size(), out);
+    (void)ptr;
+    return ec == std::errc();
 }
 
-void VcdParser::parseHeader(std::istream& is) {
-    std::string line, token;
-    std::vector<std::string> scope;
-    
-    while (std::getline(is, line)) {
-        std::istringstream iss(line);
-        iss >> token;
-        if (token.empty()) continue;
-        
-        if (token == "$timescale") {
-            std::string value, unit, endToken;
-            iss >> value >> unit;
-            if (unit == "$end") {
-                parseTimescaleToken(value);
-            } else if (!value.empty() && !unit.empty()) {
-                parseTimescaleParts(value, unit);
-            } else if (!value.empty()) {
-                parseTimescaleToken(value);
-            } else {
-                iss >> value >> unit;
-                parseTimescaleParts(value, unit);
+bool parseI32(std::string_view s, i32& out) {
+    size_t i = 0;
+    while (i < s.size() && isSpace(s[i])) i++;
+    if (i < s.size() && s[i] == '+') i++;
+    auto [ptr, ec] = std::from_chars(s.data() + i, s.data() + s.size(), out);
+    (void)ptr;
+    return ec == std::errc();
+}
+
+// Handles one line of the value-change section. onTime(t) is called for
+// every parseable '#' marker, onChange(id, value) for every value change.
+template <typename OnTime, typename OnChange>
+void parseValueLine(std::string_view line, OnTime&& onTime, OnChange&& onChange) {
+    if (line.empty()) return;
+
+    char c = line[0];
+    if (c == '#') {
+        u64 t = 0;
+        if (parseU64(line.substr(1), t)) onTime(t);
+    }
+    else if (c == 'b' || c == 'B') {
+        size_t space = line.find(' ');
+        if (space != std::string_view::npos) {
+            std::string_view bits = trimSpace(line.substr(1, space - 1));
+            std::string_view id = trimSpace(line.substr(space + 1));
+            u64 val = 0;
+            for (char b : bits) {
+                val <<= 1;
+                if (b == '1') val |= 1;
             }
+            onChange(id, val);
         }
-        else if (token == "$scope") {
-            std::string type, name;
-            iss >> type >> name;
-            scope.push_back(name);
+    }
+    else if (c == '0' || c == '1' || c == 'x' || c == 'X' || c == 'z' || c == 'Z') {
+        u64 val = (c == '1') ? 1 : 0;
+        onChange(trimSpace(line.substr(1)), val);
+    }
+}
+
+// Value changes of one chunk, grouped per signal (CSR layout):
+// changes of signal s are changes[offsets[s] .. offsets[s + 1]).
+struct ValueChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    std::vector<u32> offsets;
+    std::vector<SignalChange> changes;
+    u64 lastTime = 0;
+    bool sawTime = false;
+};
+
+// Chunk boundaries are line starts of '#' markers that parse as a time, so
+// every chunk except the first one begins with a known current time.
+bool isTimeMarkerLine(const char* p, const char* end) {
+    if (p >= end || *p != '#') return false;
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    u64 t = 0;
+    return parseU64(std::string_view(p + 1, size_t((nl ? nl : end) - p - 1)), t);
+}
+
+const char* findChunkStart(const char* from, const char* end) {
+    const char* p = from;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        if (!nl) return end;
+        p = nl + 1;
+        if (isTimeMarkerLine(p, end)) return p;
+    }
+    return end;
+}
+
+// Splits a value section into chunks of roughly approxBytes each.
+std::vector<std::pair<const char*, const char*>> splitValueSection(
+        const char* begin, const char* end, size_t approxBytes) {
+    std::vector<std::pair<const char*, const char*>> chunks;
+    const char* chunkBegin = begin;
+    while (chunkBegin < end) {
+        const char* chunkEnd = end;
+        if (size_t(end - chunkBegin) > approxBytes * 2) {
+            chunkEnd = findChunkStart(chunkBegin + approxBytes, end);
         }
-        else if (token == "$upscope") {
-            if (!scope.empty()) scope.pop_back();
+        chunks.emplace_back(chunkBegin, chunkEnd);
+        chunkBegin = chunkEnd;
+    }
+    return chunks;
+}
+
+// Runs fn(0) .. fn(count - 1) on up to `threads` threads (including the caller).
+template <typename Fn>
+void runParallel(i32 threads, size_t count, Fn&& fn) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) fn(i);
+    };
+    std::vector<std::thread> pool;
+    size_t n = std::min(size_t(std::max(threads, 1)), count);
+    for (size_t t = 1; t < n; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+}
+
+// Loads signals of a lazily opened dump. The one-pass index records, per
+// signal, the runs of value-section chunks that contain changes for it, so
+// loading a signal only rescans those chunks of the mapped file.
+class VcdLazyLoader : public SignalLoader {
+public:
+    struct Chunk {
+        const char* begin;
+        const char* end;
+    };
+    struct ChunkRun {
+        u32 first;
+        u32 last;  // exclusive
+    };
+
+    VcdLazyLoader(std::shared_ptr<MappedFile> file, size_t numSignals, VcdIdTable ids)
+        : file_(std::move(file)), ids_(std::move(ids)),
+          wanted_(numSignals, 0), runs_(numSignals) {}
+
+    // Sets data.endTime from the last time marker
+    void buildIndex(const char* begin, const char* end, i32 threads, WaveformData& data);
+
+protected:
+    void loadSignals(WaveformData& data, const size_t* indices, size_t count) override;
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    VcdIdTable ids_;
+    std::vector<Chunk> chunks_;
+    std::vector<u8> wanted_;    // signals of the load in progress
+    std::vector<std::vector<ChunkRun>> runs_;
+};
+
+void VcdLazyLoader::buildIndex(const char* begin, const char* end, i32 threads, WaveformData& data) {
+    constexpr size_t kChunkBytes = 4 << 20;
+    const size_t numSignals = runs_.size();
+
+    auto ranges = splitValueSection(begin, end, kChunkBytes);
+    chunks_.reserve(ranges.size());
+    for (const auto& r : ranges) chunks_.push_back({r.first, r.second});
+
+    struct ChunkIndex {
+        std::vector<u32> touched;
+        u64 lastTime = 0;
+        bool sawTime = false;
+    };
+    std::vector<ChunkIndex> index(chunks_.size());
+
+    runParallel(threads, chunks_.size(), [&](size_t c) {
+        auto& out = index[c];
+        std::vector<u8> seen(numSignals, 0);
+        auto onTime = [&](u64 t) {
+            out.lastTime = t;
+            out.sawTime = true;
+        };
+        auto onChange = [&](std::string_view id, u64) {
+            size_t s = ids_.find(id);
+            if (s == VcdIdTable::kNotFound || seen[s]) return;
+            seen[s] = 1;
+            out.touched.push_back(u32(s));
+        };
+        const char* p = chunks_[c].begin;
+        std::string_view line;
+        while (nextLine(p, chunks_[c].end, line)) {
+            parseValueLine(line, onTime, onChange);
         }
-        else if (token == "$var") {
-            std::string type, id, name;
-            i32 width;
-            iss >> type >> width >> id >> name;
-            
-            std::string fullName;
-            for (auto& s : scope) fullName += s + ".";
-            fullName += name;
-            
-            data_.signals.push_back({fullName, id, width, {}});
-            signalIndex_[id] = data_.signals.size() - 1;
+    });
+
+    for (u32 c = 0; c < index.size(); ++c) {
+        if (index[c].sawTime) data.endTime = index[c].lastTime;
+        for (u32 s : index[c].touched) {
+            auto& runs = runs_[s];
+            if (!runs.empty() && runs.back().last == c) {
+                runs.back().last = c + 1;
+            } else {
+                runs.push_back({c, c + 1});
+            }
         }
-        else if (token == "$enddefinitions") {
-            break;
+    }
+}
+
+void VcdLazyLoader::loadSignals(WaveformData& data, const size_t* indices, size_t count) {
+    std::vector<u32> chunkList;
+    for (size_t i = 0; i < count; ++i) {
+        size_t s = indices[i];
+        wanted_[s] = 1;
+        for (const auto& run : runs_[s]) {
+            for (u32 c = run.first; c < run.last; ++c) chunkList.push_back(c);
+        }
+    }
+
+    std::sort(chunkList.begin(), chunkList.end());
+    chunkList.erase(std::unique(chunkList.begin(), chunkList.end()), chunkList.end());
+
+    for (u32 c : chunkList) {
+        // Chunks after the first start at a '#' marker, so time 0 is only
+        // ever observed by changes that precede every marker
+        u64 currentTime = 0;
+        auto onTime = [&](u64 t) { currentTime = t; };
+        auto onChange = [&](std::string_view id, u64 val) {
+            size_t s = ids_.find(id);
+            if (s != VcdIdTable::kNotFound && wanted_[s])
+                data.signals[s].changes.push_back({currentTime, val});
+        };
+        const char* p = chunks_[c].begin;
+        std::string_view line;
+        while (nextLine(p, chunks_[c].end, line)) {
+            parseValueLine(line, onTime, onChange);
         }
     }
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t s = indices[i];
+        data.signals[s].lod.build(data.signals[s].changes);
+        wanted_[s] = 0;
+    }
+}
+
+}
+
+bool VcdParser::parse(const std::string& filename) {
+    return parse(filename, ParseMode::Mapped);
+}
+
+bool VcdParser::parse(const std::string& filename, ParseMode mode) {
+    ParseOptions options;
+    options.mode = mode;
+    return parse(filename, options);
+}
+
+bool VcdParser::parse(const std::string& filename, const ParseOptions& options) {
+    data_ = WaveformData{};
+    signalIndex_.clear();
+
+    CacheStamp stamp;
+    bool useCache = options.cache && CacheStamp::Stat(filename, stamp);
+    const std::string cachePath = WaveformCache::PathFor(filename);
+    if (useCache && WaveformCache::Open(cachePath, stamp, data_, options.lazy)) {
+        if (options.compress) compressChanges();
+        return true;
+    }
+
+    bool ok;
+    bool lazy = false;
+    i32 threads = options.threads;
+    if (threads <= 0) threads = i32(std::max(1u, std::thread::hardware_concurrency()));
+    if (options.mode == ParseMode::Mapped) {
+        lazy = options.lazy;
+        ok = lazy ? parseLazy(filename, threads) : parseMapped(filename, threads);
+    } else {
+        ok = parseStream(filename);
+    }
+
+    if (ok && !lazy) buildLods(threads);
+    if (ok && useCache && !lazy) {
+        // Best effort: an unwritable directory just means no cache next time
+        WaveformCache::Write(cachePath, data_, stamp);
+    }
+    if (ok && options.compress) compressChanges();
+    return ok;
+}
+
+void VcdParser::buildLods(i32 threads) {
+    auto& signals = data_.signals;
+    runParallel(threads, signals.size(), [&](size_t i) { signals[i].lod.build(signals[i].changes); });
 }
 
-void VcdParser::parseValues(std::istream& is) {
+void VcdParser::compressChanges() {
+    // Lazily loaded signals are still empty here; loaders keep the mode
+    for (auto& sig : data_.signals) {
+        sig.changes.compress();
+    }
+}
+
+bool VcdParser::parseStream(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file) return false;
+
     std::string line;
+    std::vector<std::string> scope;
+    while (std::getline(file, line)) {
+        if (!parseHeaderLine(line, scope)) break;
+    }
+    buildSignalIndex();
+
     u64 currentTime = 0;
-    
-    while (std::getline(is, line)) {
-        if (line.empty()) continue;
-        
-        if (line[0] == '#') {
-            try {
-                currentTime = std::stoull(line.substr(1));
-                data_.endTime = currentTime;
-            } catch (...) {}
+    auto onTime = [&](u64 t) {
+        currentTime = t;
+        data_.endTime = t;
+    };
+    auto onChange = [&](std::string_view id, u64 val) {
+        size_t index = findSignalIndex(id);
+        if (index != kNoSignal)
+            data_.signals[index].changes.push_back({currentTime, val});
+    };
+    while (std::getline(file, line)) {
+        parseValueLine(line, onTime, onChange);
+    }
+    return true;
+}
+
+bool VcdParser::parseMapped(const std::string& filename, i32 threads) {
+    MappedFile file = MappedFile::Open(filename);
+    if (!file.valid()) {
+        // Not mappable (pipe, device, ...): fall back to the stream reader
+        return parseStream(filename);
+    }
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    std::string_view line;
+    std::vector<std::string> scope;
+    while (nextLine(p, end, line)) {
+        if (!parseHeaderLine(line, scope)) break;
+    }
+    buildSignalIndex();
+
+    // Small value sections are not worth the thread start-up cost
+    constexpr size_t kMinParallelBytes = 1 << 20;
+    if (threads > 1 && size_t(end - p) >= kMinParallelBytes) {
+        parseValuesParallel(p, end, threads);
+    } else {
+        parseValues(p, end);
+    }
+    return true;
+}
+
+bool VcdParser::parseLazy(const std::string& filename, i32 threads) {
+    auto file = std::make_shared<MappedFile>(MappedFile::Open(filename));
+    if (!file->valid()) {
+        return parseStream(filename);
+    }
+
+    const char* p = file->data();
+    const char* end = p + file->size();
+    std::string_view line;
+    std::vector<std::string> scope;
+    while (nextLine(p, end, line)) {
+        if (!parseHeaderLine(line, scope)) break;
+    }
+    buildSignalIndex();
+
+    auto loader = std::make_shared<VcdLazyLoader>(file, data_.signals.size(), signalIndex_);
+    loader->buildIndex(p, end, threads, data_);
+    data_.loadedSignals.assign(data_.signals.size(), 0);
+    data_.loader = std::move(loader);
+    return true;
+}
+
+void VcdParser::parseValues(const char* begin, const char* end) {
+    u64 currentTime = 0;
+    auto onTime = [&](u64 t) {
+        currentTime = t;
+        data_.endTime = t;
+    };
+    auto onChange = [&](std::string_view id, u64 val) {
+        size_t index = findSignalIndex(id);
+        if (index != kNoSignal)
+            data_.signals[index].changes.push_back({currentTime, val});
+    };
+
+    std::string_view line;
+    while (nextLine(begin, end, line)) {
+        parseValueLine(line, onTime, onChange);
+    }
+}
+
+// Splits the value section at '#' markers, parses the chunks concurrently
+// into per-chunk per-signal runs and concatenates those in chunk order.
+void VcdParser::parseValuesParallel(const char* begin, const char* end, i32 threads) {
+    const size_t numSignals = data_.signals.size();
+    const size_t targetChunks = size_t(threads) * 4;
+    const size_t approx = size_t(end - begin) / targetChunks + 1;
+
+    std::vector<ValueChunk> chunks;
+    for (const auto& range : splitValueSection(begin, end, approx)) {
+        ValueChunk chunk;
+        chunk.begin = range.first;
+        chunk.end = range.second;
+        chunks.push_back(std::move(chunk));
+    }
+
+    auto parseChunk = [&](ValueChunk& chunk) {
+        struct Pending { u32 signal; SignalChange change; };
+        std::vector<Pending> pending;
+        std::vector<u32> counts(numSignals + 1, 0);
+        u64 currentTime = 0;
+
+        auto onTime = [&](u64 t) {
+            currentTime = t;
+            chunk.lastTime = t;
+            chunk.sawTime = true;
+        };
+        auto onChange = [&](std::string_view id, u64 val) {
+            size_t index = findSignalIndex(id);
+            if (index == kNoSignal) return;
+            pending.push_back({u32(index), {currentTime, val}});
+            counts[index]++;
+        };
+
+        const char* p = chunk.begin;
+        std::string_view line;
+        while (nextLine(p, chunk.end, line)) {
+            parseValueLine(line, onTime, onChange);
+        }
+
+        // Counting sort by signal keeps each signal's changes in time order
+        chunk.offsets.assign(numSignals + 1, 0);
+        u32 sum = 0;
+        for (size_t s = 0; s < numSignals; ++s) {
+            chunk.offsets[s] = sum;
+            sum += counts[s];
+        }
+        chunk.offsets[numSignals] = sum;
+        chunk.changes.resize(sum);
+        std::vector<u32> cursor(chunk.offsets.begin(), chunk.offsets.end() - 1);
+        for (const auto& p : pending) {
+            chunk.changes[cursor[p.signal]++] = p.change;
         }
-        else if (line[0] == 'b' || line[0] == 'B') {
-            size_t space = line.find(' ');
-            if (space != std::string::npos) {
-                std::string bits = trim(line.substr(1, space - 1));
-                std::string id = trim(line.substr(space + 1));
-                u64 val = 0;
-                for (char c : bits) {
-                    val <<= 1;
-                    if (c == '1') val |= 1;
+    };
+
+    runParallel(threads, chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+    for (const auto& chunk : chunks) {
+        if (chunk.sawTime) data_.endTime = chunk.lastTime;
+    }
+
+    constexpr size_t kSignalsPerTask = 256;
+    size_t tasks = (numSignals + kSignalsPerTask - 1) / kSignalsPerTask;
+    runParallel(threads, tasks, [&](size_t task) {
+        size_t first = task * kSignalsPerTask;
+        size_t last = std::min(numSignals, first + kSignalsPerTask);
+        for (size_t s = first; s < last; ++s) {
+            size_t total = 0;
+            for (const auto& chunk : chunks) total += chunk.offsets[s + 1] - chunk.offsets[s];
+            if (total == 0) continue;
+            auto& changes = data_.signals[s].changes;
+            changes.reserve(total);
+            for (const auto& chunk : chunks) {
+                for (size_t j = chunk.offsets[s]; j < chunk.offsets[s + 1]; ++j) {
+                    changes.push_back(chunk.changes[j]);
                 }
-                if (auto* sig = findSignal(id))
-                    sig->changes.push_back({currentTime, val});
             }
         }
-        else if (line[0] == '0' || line[0] == '1' || line[0] == 'x' || line[0] == 'X' || line[0] == 'z' || line[0] == 'Z') {
-            u64 val = (line[0] == '1') ? 1 : 0;
-            std::string id = trim(line.substr(1));
-            if (auto* sig = findSignal(id))
-                sig->changes.push_back({currentTime, val});
+    });
+}
+
+bool VcdParser::parseTimescaleParts(std::string_view value, std::string_view unit) {
+    if (value.empty() || unit.empty()) return false;
+
+    i32 val = 0;
+    if (!parseI32(value, val)) return false;
+
+    u64 mult = 1;
+    if (unit.find("ps") != std::string_view::npos) mult = 1;
+    else if (unit.find("ns") != std::string_view::npos) mult = 1000;
+    else if (unit.find("us") != std::string_view::npos) mult = 1000000;
+    else if (unit.find("ms") != std::string_view::npos) mult = 1000000000;
+    else return false;
+
+    data_.timescale = u64(val) * mult;
+    return true;
+}
+
+bool VcdParser::parseTimescaleToken(std::string_view token) {
+    size_t pos = 0;
+    while (pos < token.size() && std::isdigit(static_cast<unsigned char>(token[pos]))) pos++;
+    if (pos == 0 || pos == token.size()) return false;
+
+    return parseTimescaleParts(token.substr(0, pos), token.substr(pos));
+}
+
+// Handles one header line; returns false once $enddefinitions is reached.
+bool VcdParser::parseHeaderLine(std::string_view line, std::vector<std::string>& scope) {
+    LineTokens tokens{line};
+    std::string_view token = tokens.next();
+    if (token.empty()) return true;
+
+    if (token == "$timescale") {
+        std::string_view value = tokens.next();
+        std::string_view unit = tokens.next();
+        if (unit == "$end") {
+            parseTimescaleToken(value);
+        } else if (!value.empty() && !unit.empty()) {
+            parseTimescaleParts(value, unit);
+        } else if (!value.empty()) {
+            parseTimescaleToken(value);
+        }
+    }
+    else if (token == "$scope") {
+        tokens.next();  // scope type
+        scope.emplace_back(tokens.next());
+    }
+    else if (token == "$upscope") {
+        if (!scope.empty()) scope.pop_back();
+    }
+    else if (token == "$var") {
+        tokens.next();  // var type
+        i32 width = 0;
+        parseI32(tokens.next(), width);
+        std::string_view id = tokens.next();
+        std::string_view name = tokens.next();
+
+        std::string fullName;
+        for (auto& s : scope) fullName += s + ".";
+        fullName += name;
+
+        data_.signals.push_back({fullName, std::string(id), width, {}});
+    }
+    else if (token == "$enddefinitions") {
+        return false;
+    }
+    return true;
+}
+
+void VcdParser::buildSignalIndex() {
+    signalIndex_.build(data_.signals);
+}
+
+void VcdIdTable::clear() {
+    table_.clear();
+    directLength_ = 0;
+    fallback_.clear();
+    keys_.reset();
+}
+
+void VcdIdTable::build(const std::vector<Signal>& signals) {
+    clear();
+
+    // Size the table for the longest short code actually declared
+    for (const auto& sig : signals) {
+        if (sig.id.size() <= kMaxDirectLength)
+            directLength_ = std::max(directLength_, sig.id.size());
+    }
+    size_t slots = 1;
+    size_t levelSize = 1;
+    for (size_t len = 0; len < directLength_; ++len) {
+        levelSize *= 94;
+        slots += levelSize;
+    }
+    table_.assign(slots, kEmpty);
+
+    std::vector<size_t> fallbackSignals;
+    for (size_t i = 0; i < signals.size(); ++i) {
+        std::string_view id = signals[i].id;
+        // Later declarations of the same id win, as before
+        bool direct = !id.empty() && id.size() <= directLength_;
+        u32 key = 0;
+        for (char c : id) {
+            u32 digit = u32(static_cast<unsigned char>(c)) - 33;
+            if (digit >= 94) { direct = false; break; }
+            key = key * 94 + digit + 1;
+        }
+        if (direct) {
+            table_[key] = u32(i);
+        } else {
+            fallbackSignals.push_back(i);
         }
     }
+    if (fallbackSignals.empty()) return;
+
+    auto keys = std::make_shared<std::string>();
+    for (size_t i : fallbackSignals) *keys += signals[i].id;
+    size_t offset = 0;
+    for (size_t i : fallbackSignals) {
+        size_t len = signals[i].id.size();
+        fallback_[std::string_view(*keys).substr(offset, len)] = i;
+        offset += len;
+    }
+    keys_ = std::move(keys);
 }
 
-Signal* VcdParser::findSignal(const std::string& id) {
-    auto it = signalIndex_.find(id);
-    if (it == signalIndex_.end()) return nullptr;
-    return &data_.signals[it->second];
+size_t VcdIdTable::findFallback(std::string_view id) const {
+    if (fallback_.empty()) return kNotFound;
+    auto it = fallback_.find(id);
+    if (it == fallback_.end()) return kNotFound;
+    return it->second;
 }
 
 }
@@ -0,0 +1,253 @@
+#include "waveform_cache.hpp"
+#include "mapped_file.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace wv {
+
+namespace {
+
+constexpr char kMagic[4] = {'W', 'V', 'C', '1'};
+constexpr u32 kVersion = 1;
+
+struct CacheHeader {
+    char magic[4];
+    u32 version;
+    u64 sourceSize;
+    u64 sourceMtimeNs;
+    u64 timescale;
+    u64 endTime;
+    u64 signalCount;
+    u64 signalTableOffset;
+    u64 stringTableOffset;
+};
+
+struct CacheSignalEntry {
+    u64 nameOffset;         // into the string table; the id follows the name
+    u32 nameLen;
+    u32 idLen;
+    i32 width;
+    u8 radix;
+    u8 packedValues;        // 1: values column is a bitset
+    u8 pad[2];
+    u64 changeCount;
+    u64 timesOffset;        // absolute file offsets
+    u64 valuesOffset;
+};
+
+static_assert(sizeof(CacheHeader) == 64, "cache header layout");
+static_assert(sizeof(CacheSignalEntry) == 48, "cache signal entry layout");
+
+void appendVarint(std::vector<u8>& out, u64 v) {
+    while (v >= 0x80) {
+        out.push_back(u8(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(u8(v));
+}
+
+const u8* readVarint(const u8* p, const u8* end, u64& v) {
+    v = 0;
+    for (u32 shift = 0; p < end && shift < 64; shift += 7) {
+        u8 b = *p++;
+        v |= u64(b & 0x7F) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+// Decodes cached columns straight out of the mapped file.
+class CacheLoader : public SignalLoader {
+public:
+    CacheLoader(std::shared_ptr<MappedFile> file, const CacheSignalEntry* entries)
+        : file_(std::move(file)), entries_(entries) {}
+
+protected:
+    void loadSignals(WaveformData& data, const size_t* indices, size_t count) override {
+        for (size_t i = 0; i < count; ++i) decode(data.signals[indices[i]], indices[i]);
+    }
+
+private:
+    std::shared_ptr<MappedFile> file_;
+    const CacheSignalEntry* entries_;
+
+    void decode(Signal& sig, size_t s) {
+        CacheSignalEntry e;
+        std::memcpy(&e, &entries_[s], sizeof(e));
+        const u8* base = reinterpret_cast<const u8*>(file_->data());
+        const u8* end = base + file_->size();
+        const u8* times = base + e.timesOffset;
+        const u8* values = base + e.valuesOffset;
+
+        std::vector<u64> timeColumn;
+        timeColumn.reserve(e.changeCount);
+        u64 t = 0;
+        for (u64 i = 0; i < e.changeCount; ++i) {
+            u64 delta = 0;
+            times = readVarint(times, end, delta);
+            if (!times) break;
+            t += delta;
+            timeColumn.push_back(t);
+        }
+
+        // The on-disk bitset is LSB-first bytes, i.e. little-endian u64 words
+        size_t n = timeColumn.size();
+        std::vector<u64> valueColumn(e.packedValues ? (n + 63) / 64 : n, 0);
+        std::memcpy(valueColumn.data(), values, e.packedValues ? (n + 7) / 8 : n * sizeof(u64));
+        auto& changes = sig.changes;
+        bool compress = changes.compressed();
+        changes = SignalChanges::FromColumns(std::move(timeColumn), std::move(valueColumn), e.packedValues != 0);
+        sig.lod.build(changes);
+        if (compress) changes.compress();
+    }
+};
+
+}
+
+bool CacheStamp::Stat(const std::string& path, CacheStamp& out) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    out.size = u64(st.st_size);
+    out.mtimeNs = u64(st.st_mtim.tv_sec) * 1000000000ull + u64(st.st_mtim.tv_nsec);
+    return true;
+}
+
+bool WaveformCache::Write(const std::string& path, const WaveformData& data, const CacheStamp& source) {
+    std::string tmpPath = path + ".tmp";
+    std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!f) return false;
+
+    const size_t count = data.signals.size();
+    CacheHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sourceSize = source.size;
+    header.sourceMtimeNs = source.mtimeNs;
+    header.timescale = data.timescale;
+    header.endTime = data.endTime;
+    header.signalCount = count;
+    header.signalTableOffset = sizeof(CacheHeader);
+    header.stringTableOffset = header.signalTableOffset + count * sizeof(CacheSignalEntry);
+
+    std::vector<CacheSignalEntry> entries(count);
+    std::vector<u8> strings;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& sig = data.signals[i];
+        entries[i].nameOffset = strings.size();
+        entries[i].nameLen = u32(sig.name.size());
+        entries[i].idLen = u32(sig.id.size());
+        strings.insert(strings.end(), sig.name.begin(), sig.name.end());
+        strings.insert(strings.end(), sig.id.begin(), sig.id.end());
+    }
+
+    // Header and signal table are rewritten once the column offsets are known
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(count * sizeof(CacheSignalEntry)));
+    f.write(reinterpret_cast<const char*>(strings.data()), std::streamsize(strings.size()));
+
+    u64 offset = header.stringTableOffset + strings.size();
+    std::vector<u8> column;
+    for (size_t i = 0; i < count; ++i) {
+        const auto& sig = data.signals[i];
+        auto& e = entries[i];
+        e.width = sig.width;
+        e.radix = u8(sig.radix);
+        e.changeCount = sig.changes.size();
+
+        column.clear();
+        u64 prev = 0;
+        for (auto it = sig.changes.begin(); it != sig.changes.end(); ++it) {
+            appendVarint(column, it.time() - prev);
+            prev = it.time();
+        }
+        const bool packed = sig.changes.packed();
+        e.timesOffset = offset;
+        e.packedValues = packed ? 1 : 0;
+
+        // Keep raw u64 value columns 8-byte aligned within the file
+        while (!packed && (offset + column.size()) % 8 != 0) column.push_back(0);
+        e.valuesOffset = offset + column.size();
+
+        // Both layouts match the in-memory value words byte for byte
+        const u8* bytes = reinterpret_cast<const u8*>(sig.changes.valueWords().data());
+        size_t n = sig.changes.size();
+        column.insert(column.end(), bytes, bytes + (packed ? (n + 7) / 8 : n * sizeof(u64)));
+        f.write(reinterpret_cast<const char*>(column.data()), std::streamsize(column.size()));
+        offset += column.size();
+    }
+
+    f.seekp(0);
+    f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(count * sizeof(CacheSignalEntry)));
+    f.close();
+    if (!f) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool WaveformCache::Open(const std::string& path, const CacheStamp& source, WaveformData& data,
+                         bool lazy) {
+    auto file = std::make_shared<MappedFile>(MappedFile::Open(path));
+    if (!file->valid() || file->size() < sizeof(CacheHeader)) return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+    if (header.sourceSize != source.size || header.sourceMtimeNs != source.mtimeNs) return false;
+
+    const u64 fileSize = file->size();
+    const u64 count = header.signalCount;
+    if (header.signalTableOffset > fileSize ||
+        count > (fileSize - header.signalTableOffset) / sizeof(CacheSignalEntry)) return false;
+    if (header.stringTableOffset > fileSize) return false;
+    const u64 stringsSize = fileSize - header.stringTableOffset;
+
+    const auto* entries = reinterpret_cast<const CacheSignalEntry*>(file->data() + header.signalTableOffset);
+    const char* strings = file->data() + header.stringTableOffset;
+
+    WaveformData result;
+    result.timescale = header.timescale;
+    result.endTime = header.endTime;
+    result.signals.reserve(count);
+    for (u64 i = 0; i < count; ++i) {
+        CacheSignalEntry e;
+        std::memcpy(&e, &entries[i], sizeof(e));
+        // Lengths are compared with what is left, so no sum can wrap
+        if (e.nameOffset > stringsSize || e.nameLen > stringsSize - e.nameOffset ||
+            e.idLen > stringsSize - e.nameOffset - e.nameLen) return false;
+        if (e.timesOffset > fileSize || e.valuesOffset > fileSize) return false;
+        const u64 valuesLeft = fileSize - e.valuesOffset;
+        if (e.packedValues ? e.changeCount / 8 + (e.changeCount % 8 != 0) > valuesLeft
+                           : e.changeCount > valuesLeft / sizeof(u64)) return false;
+
+        Signal sig;
+        sig.name.assign(strings + e.nameOffset, e.nameLen);
+        sig.id.assign(strings + e.nameOffset + e.nameLen, e.idLen);
+        sig.width = e.width;
+        sig.radix = static_cast<Radix>(e.radix);
+        result.signals.push_back(std::move(sig));
+    }
+
+    data = std::move(result);
+    auto loader = std::make_shared<CacheLoader>(file, entries);
+    if (lazy) {
+        data.loadedSignals.assign(count, 0);
+        data.loader = std::move(loader);
+    } else {
+        std::vector<size_t> all(count);
+        for (u64 i = 0; i < count; ++i) all[i] = size_t(i);
+        loader->load(data, all.data(), all.size());
+        data.loadedSignals.clear();
+    }
+    return true;
+}
+
+}
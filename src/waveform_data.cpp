@@ -0,0 +1,237 @@
+#include "waveform_data.hpp"
+#include <algorithm>
+
+namespace wv {
+
+SignalChanges::SignalChanges(std::initializer_list<SignalChange> changes) {
+    reserve(changes.size());
+    for (const auto& change : changes) {
+        push_back(change);
+    }
+}
+
+SignalChanges SignalChanges::FromColumns(std::vector<u64> times, std::vector<u64> valueWords, bool packed) {
+    SignalChanges result;
+    size_t words = packed ? (times.size() + 63) / 64 : times.size();
+    valueWords.resize(words, 0);
+    if (packed && (times.size() & 63) != 0) {
+        // Keep the bits past the end clear so push_back can OR into the last word
+        valueWords.back() &= (u64(1) << (times.size() & 63)) - 1;
+    }
+    result.count_ = times.size();
+    result.lastTime_ = times.empty() ? 0 : times.back();
+    result.times_ = std::move(times);
+    result.values_ = std::move(valueWords);
+    result.packed_ = packed;
+    return result;
+}
+
+size_t SignalChanges::lowerBound(u64 t) const {
+    if (!compressed_) {
+        return size_t(std::lower_bound(times_.begin(), times_.end(), t) - times_.begin());
+    }
+    // Last block whose first time is below t holds the answer, or its end does
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), t,
+                               [](const Block& b, u64 v) { return b.firstTime < v; });
+    if (it == blocks_.begin()) return 0;
+    size_t block = size_t(it - blocks_.begin()) - 1;
+    size_t i = block * kBlockSize;
+    size_t last = std::min(count_, i + kBlockSize);
+    size_t pos = blocks_[block].offset;
+    u64 time = blocks_[block].firstTime;
+    while (++i < last) {
+        time += readDelta(deltas_, pos);
+        if (time >= t) return i;
+    }
+    return last;
+}
+
+size_t SignalChanges::upperBound(u64 t) const {
+    return t == ~u64(0) ? count_ : lowerBound(t + 1);
+}
+
+size_t SignalChanges::upperBound(u64 t, size_t hint) const {
+    if (compressed_) return upperBound(t);
+    hint = std::min(hint, count_);
+    const u64* times = times_.data();
+    size_t lo, hi;
+    if (hint < count_ && times[hint] <= t) {
+        // Answer is past the hint: gallop right
+        lo = hint + 1;
+        hi = lo;
+        for (size_t step = 1; hi < count_ && times[hi] <= t; step *= 2) {
+            lo = hi + 1;
+            hi = lo + step;
+        }
+        hi = std::min(hi, count_);
+    } else {
+        // Answer is at or before the hint: gallop left
+        hi = hint;
+        lo = hint;
+        for (size_t step = 1; lo > 0 && times[lo - 1] > t; step *= 2) {
+            hi = lo - 1;
+            lo = lo > step ? lo - step : 0;
+        }
+    }
+    return size_t(std::upper_bound(times + lo, times + hi, t) - times);
+}
+
+void SignalChanges::reserve(size_t n) {
+    if (!compressed_) times_.reserve(n);
+    values_.reserve(packed_ ? (n + 63) / 64 : n);
+}
+
+void SignalChanges::clear() {
+    times_.clear();
+    blocks_.clear();
+    deltas_.clear();
+    values_.clear();
+    count_ = 0;
+    lastTime_ = 0;
+    packed_ = true;
+}
+
+void SignalChanges::shrink_to_fit() {
+    times_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+    deltas_.shrink_to_fit();
+    values_.shrink_to_fit();
+}
+
+void SignalChanges::compress() {
+    if (compressed_) return;
+    compressed_ = true;
+    std::vector<u64> times = std::move(times_);
+    times_ = {};
+    blocks_.reserve((times.size() + kBlockSize - 1) / kBlockSize);
+    for (size_t i = 0; i < times.size(); ++i) {
+        appendCompressedTime(i, times[i]);
+        lastTime_ = times[i];
+    }
+    blocks_.shrink_to_fit();
+    deltas_.shrink_to_fit();
+}
+
+size_t SignalChanges::memoryBytes() const {
+    return times_.capacity() * sizeof(u64) + blocks_.capacity() * sizeof(Block) +
+           deltas_.capacity() + values_.capacity() * sizeof(u64);
+}
+
+u64 SignalChanges::decodeTime(size_t i, size_t* nextPos) const {
+    if (!compressed_) return times_[i];
+    const Block& block = blocks_[i / kBlockSize];
+    size_t pos = block.offset;
+    u64 time = block.firstTime;
+    for (size_t k = i % kBlockSize; k > 0; --k) {
+        time += readDelta(deltas_, pos);
+    }
+    if (nextPos) *nextPos = pos;
+    return time;
+}
+
+void SignalChanges::appendCompressedTime(size_t i, u64 time) {
+    if (i % kBlockSize == 0) {
+        blocks_.push_back({time, deltas_.size()});
+        return;
+    }
+    u64 v = time - lastTime_;
+    while (v >= 0x80) {
+        deltas_.push_back(u8(v) | 0x80);
+        v >>= 7;
+    }
+    deltas_.push_back(u8(v));
+}
+
+void SignalChanges::unpack() {
+    std::vector<u64> values;
+    values.reserve(compressed_ ? count_ + 1 : times_.capacity());
+    for (size_t i = 0; i < count_; ++i) {
+        values.push_back((values_[i >> 6] >> (i & 63)) & 1);
+    }
+    values_ = std::move(values);
+    packed_ = false;
+}
+
+void SignalLod::build(const SignalChanges& changes) {
+    levels_.clear();
+    const size_t n = changes.size();
+    if (n < kMinChanges) return;
+
+    const u64 firstTime = changes.front().time;
+    const u64 span = changes.back().time - firstTime;
+    const u64 target = std::max<u64>(1, span / n * kChangesPerBucket);
+    baseShift_ = 0;
+    while (baseShift_ < 63 && (u64(1) << baseShift_) < target) baseShift_++;
+
+    std::vector<Bucket> base;
+    base.reserve(n / kChangesPerBucket + 1);
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        u64 index = it.time() >> baseShift_;
+        u64 v = it.value();
+        if (base.empty() || base.back().index != index) {
+            base.push_back({index, 1, v, v, v, v});
+        } else {
+            Bucket& b = base.back();
+            b.count++;
+            b.last = v;
+            b.min = std::min(b.min, v);
+            b.max = std::max(b.max, v);
+        }
+    }
+    levels_.push_back(std::move(base));
+
+    while (levels_.back().size() > 1 && baseShift_ + levels_.size() < 64) {
+        const auto& below = levels_.back();
+        std::vector<Bucket> up;
+        up.reserve(below.size() / 2 + 1);
+        for (const Bucket& b : below) {
+            u64 index = b.index >> 1;
+            if (up.empty() || up.back().index != index) {
+                up.push_back(b);
+                up.back().index = index;
+            } else {
+                Bucket& u = up.back();
+                u.count += b.count;
+                u.last = b.last;
+                u.min = std::min(u.min, b.min);
+                u.max = std::max(u.max, b.max);
+            }
+        }
+        levels_.push_back(std::move(up));
+    }
+}
+
+i32 SignalLod::levelFor(f64 maxSpan) const {
+    i32 level = -1;
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        if (f64(u64(1) << shift(l)) > maxSpan) break;
+        level = i32(l);
+    }
+    return level;
+}
+
+size_t SignalLod::memoryBytes() const {
+    size_t bytes = 0;
+    for (const auto& level : levels_) bytes += level.capacity() * sizeof(Bucket);
+    return bytes;
+}
+
+void SignalLoader::load(WaveformData& data, const size_t* indices, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    data.loadedSignals.resize(data.signals.size(), 0);
+    pending_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        size_t s = indices[i];
+        if (s >= data.loadedSignals.size() || data.loadedSignals[s]) continue;
+        data.loadedSignals[s] = 1;
+        pending_.push_back(s);
+    }
+    if (!pending_.empty()) loadSignals(data, pending_.data(), pending_.size());
+}
+
+bool SignalLoader::isLoaded(const WaveformData& data, size_t index) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index < data.loadedSignals.size() && data.loadedSignals[index];
+}
+
+}
@@ -1,19 +1,85 @@
 #include "waveform_viewer.hpp"
 #include "canvas.hpp"
+#include "glyph_cache.hpp"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <thread>
 
 namespace wv {
 
-void WaveformViewer::setData(const WaveformData* data) {
+// Upper bound on a glyph advance, for the extent of text drawn to the right
+// of its anchor; the fonts the viewer is used with are narrower
+static constexpr f32 kMaxGlyphAdvance = 10;
+
+// Adds the part of r not yet covered to a set of disjoint rects, split
+// around the rects it overlaps. Merging into bounding boxes instead would
+// turn a cursor line and its label into one tall wide box.
+static void addDamage(std::vector<Rect>& rects, Rect r, size_t from = 0) {
+    if (r.w <= 0 || r.h <= 0) return;
+    for (size_t i = from; i < rects.size(); ++i) {
+        Rect e = rects[i];
+        f32 x1 = std::max(r.x, e.x), x2 = std::min(r.x + r.w, e.x + e.w);
+        f32 y1 = std::max(r.y, e.y), y2 = std::min(r.y + r.h, e.y + e.h);
+        if (x1 >= x2 || y1 >= y2) continue;
+        // Bands above and below e, then the pieces left and right of it
+        addDamage(rects, {r.x, r.y, r.w, y1 - r.y}, i + 1);
+        addDamage(rects, {r.x, y2, r.w, r.y + r.h - y2}, i + 1);
+        addDamage(rects, {r.x, y1, x1 - r.x, y2 - y1}, i + 1);
+        addDamage(rects, {x2, y1, r.x + r.w - x2, y2 - y1}, i + 1);
+        return;
+    }
+    rects.push_back(r);
+}
+
+// Whole pixels of a w x h target that the recording's draw ops can touch.
+// Rasterizers truncate coordinates, so bounds ending at v reach the pixel
+// containing v; text is measured with the glyphs that draw it.
+static void recordingArea(const Recording& recording, GlyphCache* glyphs, i32 w, i32 h,
+                          std::vector<Rect>& rects) {
+    rects.clear();
+    const auto& arena = recording.arena();
+    for (const CompactDrawOp& op : recording.ops()) {
+        Rect b = op.bounds;
+        if (op.type == DrawOp::Type::SetClip || op.type == DrawOp::Type::ClearClip) continue;
+        if (op.type == DrawOp::Type::Text) {
+            if (!glyphs) continue;
+            Point p = op.data.text.pos;
+            b = glyphs->textBounds(i32(p.x), i32(p.y),
+                std::string_view(arena.getString(op.data.text.offset), op.data.text.len));
+            if (b.w <= 0 || b.h <= 0) continue;
+        }
+        if (b.x + b.w < 0 || b.y + b.h < 0) continue;
+        f32 x1 = std::floor(std::clamp(b.x, 0.0f, f32(w)));
+        f32 y1 = std::floor(std::clamp(b.y, 0.0f, f32(h)));
+        f32 x2 = std::min(f32(w), std::floor(std::min(b.x + b.w, f32(w))) + 1);
+        f32 y2 = std::min(f32(h), std::floor(std::min(b.y + b.h, f32(h))) + 1);
+        addDamage(rects, {x1, y1, x2 - x1, y2 - y1});
+    }
+}
+
+WaveformViewer::WaveformViewer() = default;
+
+WaveformViewer::~WaveformViewer() {
+    setAsync(false);
+}
+
+void WaveformViewer::setData(WaveformData* data) {
     data_ = data;
+    dataVersion_++;
     if (data_ && data_->endTime > 0) {
         timeScale_ = f64(w_ - nameWidth_) / data_->endTime;
     }
+    firstRow_ = 0;
+    rowCache_.clear();
     signalRadix_.clear();
+    valueHints_.clear();
     if (data_) {
+        valueHints_.assign(data_->signals.size(), 0);
         signalRadix_.reserve(data_->signals.size());
         for (const auto& sig : data_->signals) {
             signalRadix_.push_back(sig.radix);
@@ -26,8 +92,22 @@ void WaveformViewer::setData(const WaveformData* data) {
 
 void WaveformViewer::paint(Surface* target) {
     if (!data_ || !target) return;
+    Pixmap* pixels = target->peekPixels();
+    if (!async_ && scrollReuse_ && pixels && pixels->width() == w_ && pixels->height() == h_) {
+        paintRaster(target, pixels);
+        return;
+    }
+    
+    // Composed without the retained base; the next raster paint starts over
+    rasterBase_.target = nullptr;
+    damage_.assign(1, {0, 0, f32(w_), f32(h_)});
+    if (async_) {
+        paintAsync(target);
+        return;
+    }
     
     ensureLayers();
+    loadVisibleSignals();
     if (staticLayer_.dirty) updateStaticLayer();
     if (waveformLayer_.dirty) updateWaveformLayer();
     if (overlayLayer_.dirty) updateOverlayLayer();
@@ -37,13 +117,57 @@ void WaveformViewer::paint(Surface* target) {
     if (overlayLayer_.recording) target->submit(*overlayLayer_.recording);
 }
 
-void WaveformViewer::drawTimeScale(Canvas* c) {
+i32 WaveformViewer::visibleRowCount() const {
+    if (!data_) return 0;
+    i32 pitch = signalHeight_ + 5;
+    i32 rows = std::max(0, (h_ - 30 + pitch - 1) / pitch);
+    return std::clamp(static_cast<i32>(data_->signals.size()) - firstRow_, 0, rows);
+}
+
+i32 WaveformViewer::maxScrollRow() const {
+    if (!data_) return 0;
+    i32 fullRows = std::max(1, (h_ - 30) / (signalHeight_ + 5));
+    return std::max(0, static_cast<i32>(data_->signals.size()) - fullRows);
+}
+
+void WaveformViewer::setScrollRow(i32 row) {
+    row = std::clamp(row, 0, maxScrollRow());
+    if (row == firstRow_) return;
+    firstRow_ = row;
+    needsRepaint_ = true;
+    staticLayer_.dirty = true;
+    waveformLayer_.dirty = true;
+    overlayLayer_.dirty = true;
+}
+
+void WaveformViewer::scrollToRow(i32 row) {
+    i32 fullRows = std::max(1, (h_ - 30) / (signalHeight_ + 5));
+    if (row < firstRow_) setScrollRow(row);
+    else if (row >= firstRow_ + fullRows) setScrollRow(row - fullRows + 1);
+}
+
+void WaveformViewer::loadVisibleSignals() {
+    if (!data_->loader) return;
+    i32 rows = visibleRowCount();
+    visibleIndices_.clear();
+    for (i32 i = 0; i < rows; ++i) {
+        visibleIndices_.push_back(size_t(firstRow_ + i));
+    }
+    data_->ensureLoaded(visibleIndices_.data(), visibleIndices_.size());
+}
+
+void WaveformViewer::drawTimeScale(Canvas* c, Rect span) {
     Color tickColor = {90, 90, 90, 255};
     Color textColor = {180, 180, 180, 255};
     f32 y = 20;
     
     f64 visibleStart = timeOffset_;
     f64 visibleEnd = timeOffset_ + (w_ - nameWidth_) / timeScale_;
+    f32 spanX0 = span.x, spanX1 = span.x + span.w;
+    f32 reach = spanX0 > nameWidth_ ? timeLabelReach() : 0;
+    // Tick lines only as far as the span reaches; the pixels are the same
+    f32 lineTop = std::max(y, span.y);
+    f32 lineBottom = std::min(f32(h_), span.y + span.h);
     
     f64 step = 1;
     while (step * timeScale_ < 80) step *= 10;
@@ -51,8 +175,9 @@ void WaveformViewer::drawTimeScale(Canvas* c) {
     f64 t = std::floor(visibleStart / step) * step;
     while (t <= visibleEnd) {
         f32 x = f32(nameWidth_ + (t - timeOffset_) * timeScale_);
-        if (x >= nameWidth_) {
-            c->drawLine({x, y}, {x, f32(h_)}, tickColor, 1);
+        if (x > spanX1) break;
+        if (x >= nameWidth_ && x + reach >= spanX0) {
+            if (lineTop < lineBottom) c->drawLine({x, lineTop}, {x, lineBottom}, tickColor, 1);
             char buf[32];
             std::snprintf(buf, sizeof(buf), "%.0f", t);
             c->drawText({x + 2, y - 5}, buf, textColor);
@@ -61,13 +186,27 @@ void WaveformViewer::drawTimeScale(Canvas* c) {
     }
 }
 
+f32 WaveformViewer::timeLabelReach() const {
+    char buf[32];
+    f64 visibleEnd = timeOffset_ + (w_ - nameWidth_) / timeScale_;
+    // Widest label plus a sign
+    i32 len = std::snprintf(buf, sizeof(buf), "%.0f", std::max(std::abs(visibleEnd), std::abs(timeOffset_)));
+    return 2 + f32(len + 1) * kMaxGlyphAdvance;
+}
+
+f32 WaveformViewer::busLabelReach(const Signal& sig, Radix radix) const {
+    u64 maxValue = sig.width >= 64 ? ~0ull : (1ull << std::max(sig.width, 1)) - 1;
+    return 6 + f32(formatValue(maxValue, sig.width, radix).size()) * kMaxGlyphAdvance;
+}
+
 void WaveformViewer::drawSignalNames(Canvas* c) {
     c->fillRect({0, 0, f32(nameWidth_), f32(h_)}, {45, 45, 45, 255});
     c->drawLine({f32(nameWidth_), 0}, {f32(nameWidth_), f32(h_)}, {70, 70, 70, 255}, 1);
     
     i32 y = 30;
-    i32 idx = 0;
-    for (const auto& sig : data_->signals) {
+    i32 end = firstRow_ + visibleRowCount();
+    for (i32 idx = firstRow_; idx < end; ++idx) {
+        const auto& sig = data_->signals[idx];
         // Highlight selected signal
         if (idx == selectedSignal_) {
             c->fillRect({0, f32(y), f32(nameWidth_), f32(signalHeight_)}, {60, 60, 80, 255});
@@ -76,25 +215,25 @@ void WaveformViewer::drawSignalNames(Canvas* c) {
         c->drawText({5, f32(y) + f32(signalHeight_) * 0.5f}, sig.name, {220, 220, 220, 255});
         
         y += signalHeight_ + 5;
-        idx++;
     }
 }
 
 void WaveformViewer::drawSignalValues(Canvas* c) {
     i32 y = 30;
-    i32 idx = 0;
-    for (const auto& sig : data_->signals) {
-        u64 val = getValueAtTime(sig, cursorTime_);
+    i32 end = firstRow_ + visibleRowCount();
+    for (i32 idx = firstRow_; idx < end; ++idx) {
+        const auto& sig = data_->signals[idx];
+        u64 val = getValueAtTime(sig, cursorTime_, &valueHints_[idx]);
         Radix radix = signalRadixForIndex(idx, sig);
         std::string valStr = formatValue(val, sig.width, radix);
         c->drawText({f32(nameWidth_ - 8 - valStr.length() * 7), f32(y) + f32(signalHeight_) * 0.5f},
                     valStr, {150, 220, 150, 255});
         y += signalHeight_ + 5;
-        idx++;
     }
 }
 
-void WaveformViewer::drawSignal(Canvas* c, const Signal& sig, i32 y, i32 signalIndex) {
+void WaveformViewer::drawSignal(Canvas* c, const Signal& sig, i32 y, i32 signalIndex,
+                                f32 spanX0, f32 spanX1) {
     Color lineColor = {50, 200, 50, 255};
     f32 high = f32(y);
     f32 low = f32(y + signalHeight_ - 5);
@@ -102,60 +241,201 @@ void WaveformViewer::drawSignal(Canvas* c, const Signal& sig, i32 y, i32 signalI
     
     if (sig.changes.empty()) return;
     
+    // More than one change per pixel: draw from the summary instead
+    i32 level = sig.lod.levelFor(1.0 / timeScale_);
+    if (level >= 0) {
+        drawSignalLod(c, sig, y, signalIndex, size_t(level), spanX0, spanX1);
+        return;
+    }
+    
+    // Start at the last change before the left edge of the span; it sets
+    // the level (or bus segment) visible there. Bus labels run right of
+    // their segment start, so those look further back.
+    Radix radix = sig.width > 1 ? signalRadixForIndex(signalIndex, sig) : Radix::Hex;
+    f32 reach = spanX0 > xOff && sig.width > 1 ? busLabelReach(sig, radix) : 0;
+    f64 spanStart = timeOffset_ + (spanX0 - reach - xOff) / timeScale_;
+    size_t first = spanStart > 0 ? sig.changes.lowerBound(u64(std::ceil(spanStart))) : 0;
+    size_t start = first > 0 ? first - 1 : 0;
+    
     if (sig.width > 1) {
-        Color busColor = {80, 180, 220, 255};
-        f32 mid = (high + low) / 2;
-        Radix radix = signalRadixForIndex(signalIndex, sig);
-        
-        for (size_t i = 0; i < sig.changes.size(); ++i) {
-            f32 x1 = xOff + f32((sig.changes[i].time - timeOffset_) * timeScale_);
-            f32 x2 = (i + 1 < sig.changes.size()) 
-                ? xOff + f32((sig.changes[i + 1].time - timeOffset_) * timeScale_)
+        for (auto it = sig.changes.seek(start), end = sig.changes.end(); it != end;) {
+            SignalChange change = *it;
+            ++it;
+            f32 x1 = xOff + f32((change.time - timeOffset_) * timeScale_);
+            f32 x2 = it != end
+                ? xOff + f32((it.time() - timeOffset_) * timeScale_)
                 : f32(w_);
             
-            if (x2 < xOff || x1 > w_) continue;
-            x1 = std::max(x1, xOff);
-            x2 = std::min(x2, f32(w_));
-            
-            f32 slant = 3;
-            if (x2 - x1 > slant * 2) {
-                Point pts[] = {
-                    {x1, mid}, {x1 + slant, high + 2}, {x2 - slant, high + 2},
-                    {x2, mid}, {x2 - slant, low - 2}, {x1 + slant, low - 2}, {x1, mid}
-                };
-                c->drawPolyline(pts, 7, busColor, 1);
-                
-                if (x2 - x1 > 40) {
-                    std::string val = formatValue(sig.changes[i].value, sig.width, radix);
-                    c->drawText({x1 + slant + 3, mid - 5}, val, {200, 230, 255, 255});
-                }
-            }
+            if (x1 > spanX1) break;
+            if (x2 < xOff) continue;
+            drawBusSegment(c, std::max(x1, xOff), std::min(x2, f32(w_)), high, low,
+                           change.value, sig.width, radix);
         }
         return;
     }
     
     f32 lastX = xOff;
-    f32 lastY = sig.changes[0].value ? high : low;
+    f32 lastY = sig.changes.value(start) ? high : low;
+    
+    // Changes sharing a pixel column draw at most one edge there: the
+    // column's edges all span high to low, and the level lines between
+    // them stay inside it, so only the line into the column's first change
+    // and one edge are emitted. Bursts too short for the LOD levels then
+    // cost two ops per column.
+    f32 column = -1;
+    f32 edgeX = -1;
+    auto flushEdge = [&]() {
+        if (edgeX >= 0) c->drawLine({edgeX, high}, {edgeX, low}, lineColor, 1);
+        edgeX = -1;
+    };
     
-    for (size_t i = 0; i < sig.changes.size(); ++i) {
-        f32 x = xOff + f32((sig.changes[i].time - timeOffset_) * timeScale_);
-        f32 newY = sig.changes[i].value ? high : low;
+    for (auto it = sig.changes.seek(start), end = sig.changes.end(); it != end; ++it) {
+        f32 x = xOff + f32((it.time() - timeOffset_) * timeScale_);
+        f32 newY = it.value() ? high : low;
         
         if (x < xOff) { lastX = x; lastY = newY; continue; }
-        if (lastX > w_) break;
+        if (lastX > spanX1) break;
         
-        c->drawLine({std::max(lastX, xOff), lastY}, {x, lastY}, lineColor, 1);
-        if (lastY != newY)
-            c->drawLine({x, lastY}, {x, newY}, lineColor, 1);
+        if (!columnDecimation_) {
+            c->drawLine({std::max(lastX, xOff), lastY}, {x, lastY}, lineColor, 1);
+            if (lastY != newY)
+                c->drawLine({x, lastY}, {x, newY}, lineColor, 1);
+        } else {
+            if (std::floor(x) != column) {
+                flushEdge();
+                column = std::floor(x);
+                c->drawLine({std::max(lastX, xOff), lastY}, {x, lastY}, lineColor, 1);
+            }
+            if (lastY != newY) edgeX = x;
+        }
         
         lastX = x;
         lastY = newY;
     }
+    flushEdge();
     
-    if (lastX < w_)
+    if (lastX < w_ && lastX <= spanX1)
         c->drawLine({lastX, lastY}, {f32(w_), lastY}, lineColor, 1);
 }
 
+void WaveformViewer::drawBusSegment(Canvas* c, f32 x1, f32 x2, f32 high, f32 low, u64 value,
+                                    i32 width, Radix radix) {
+    Color busColor = {80, 180, 220, 255};
+    f32 mid = (high + low) / 2;
+    f32 slant = 3;
+    if (x2 - x1 > slant * 2) {
+        Point pts[] = {
+            {x1, mid}, {x1 + slant, high + 2}, {x2 - slant, high + 2},
+            {x2, mid}, {x2 - slant, low - 2}, {x1 + slant, low - 2}, {x1, mid}
+        };
+        c->drawPolyline(pts, 7, busColor, 1);
+        
+        if (x2 - x1 > 40) {
+            std::string val = formatValue(value, width, radix);
+            c->drawText({x1 + slant + 3, mid - 5}, val, {200, 230, 255, 255});
+        }
+    }
+}
+
+// Walks the LOD buckets one pixel column at a time. Columns with a single
+// change are drawn as an edge, runs of columns with several changes as one
+// filled activity block, so the op count is bounded by the row width. A
+// column whose changes all set one value (min == max) is no activity: it
+// draws as that single change, or nothing if the value is unchanged.
+// Columns left of the span are still walked (the run state depends on
+// them) but emit nothing.
+void WaveformViewer::drawSignalLod(Canvas* c, const Signal& sig, i32 y, i32 signalIndex, size_t level,
+                                   f32 spanX0, f32 spanX1) {
+    Color lineColor = {50, 200, 50, 255};
+    Color busColor = {80, 180, 220, 255};
+    f32 high = f32(y);
+    f32 low = f32(y + signalHeight_ - 5);
+    const bool bus = sig.width > 1;
+    Radix radix = bus ? signalRadixForIndex(signalIndex, sig) : Radix::Hex;
+    f32 emitX0 = spanX0 - (bus && spanX0 > nameWidth_ ? busLabelReach(sig, radix) : 0);
+    
+    const auto& buckets = sig.lod.level(level);
+    const u32 shift = sig.lod.shift(level);
+    u64 startIndex = timeOffset_ > 0 ? u64(timeOffset_) >> shift : 0;
+    auto it = std::lower_bound(buckets.begin(), buckets.end(), startIndex,
+                               [](const SignalLod::Bucket& b, u64 v) { return b.index < v; });
+    u64 value = it == buckets.begin() ? buckets.front().first : (it - 1)->last;
+    
+    f32 segStart = f32(nameWidth_);
+    i32 denseStart = -1, denseEnd = -1;
+    
+    auto drawFlat = [&](f32 x1, f32 x2) {
+        if (x2 <= x1 || x2 < emitX0) return;
+        if (bus) {
+            drawBusSegment(c, x1, x2, high, low, value, sig.width, radix);
+        } else {
+            f32 levelY = value ? high : low;
+            c->drawLine({x1, levelY}, {x2, levelY}, lineColor, 1);
+        }
+    };
+    auto closeDense = [&]() {
+        if (denseStart < 0) return;
+        if (denseEnd >= spanX0) {
+            f32 inset = bus ? 2.0f : 0.0f;
+            c->fillRect({f32(denseStart), high + inset, f32(denseEnd - denseStart + 1), low - high - 2 * inset},
+                        bus ? busColor : lineColor);
+        }
+        segStart = f32(denseEnd + 1);
+        denseStart = -1;
+    };
+    
+    i32 col = -1;
+    u64 count = 0;
+    u64 colFirst = 0, colLast = 0, colMin = 0, colMax = 0;
+    auto flushColumn = [&]() {
+        if (count == 0) return;
+        const bool steady = colMin == colMax;
+        if (steady && colMin == value) return;
+        if ((count > 1 && !steady) || (denseStart >= 0 && col == denseEnd + 1)) {
+            if (denseStart >= 0 && col > denseEnd + 1) closeDense();
+            if (denseStart < 0) {
+                drawFlat(segStart, f32(col));
+                denseStart = col;
+            }
+            denseEnd = col;
+        } else {
+            closeDense();
+            drawFlat(segStart, f32(col));
+            if (!bus && col >= spanX0 && (value != 0) != (colFirst != 0)) {
+                c->drawLine({f32(col), high}, {f32(col), low}, lineColor, 1);
+            }
+            segStart = f32(col);
+        }
+        value = colLast;
+    };
+    
+    // The flat run after the last drawn column ends at the next event
+    // column, or at the view edge
+    i32 flatEnd = w_;
+    for (; it != buckets.end(); ++it) {
+        f64 t = f64(it->index << shift);
+        i32 x = i32(std::floor(nameWidth_ + (t - timeOffset_) * timeScale_));
+        x = std::max(x, nameWidth_);
+        if (x >= w_) break;
+        if (x != col && x >= spanX1) { flatEnd = x; break; }
+        if (x != col) {
+            flushColumn();
+            col = x;
+            count = 0;
+            colFirst = it->first;
+            colMin = it->min;
+            colMax = it->max;
+        }
+        count += it->count;
+        colLast = it->last;
+        colMin = std::min(colMin, it->min);
+        colMax = std::max(colMax, it->max);
+    }
+    flushColumn();
+    closeDense();
+    drawFlat(segStart, f32(flatEnd));
+}
+
 void WaveformViewer::drawCursor(Canvas* c) {
     f32 x = f32(nameWidth_ + (cursorTime_ - timeOffset_) * timeScale_);
     if (x < nameWidth_ || x > w_) return;
@@ -176,6 +456,9 @@ void WaveformViewer::ensureLayers() {
     }
     layerW_ = w_;
     layerH_ = h_;
+    // Row surfaces cull ops to their size; rows recorded at the old width
+    // are re-recorded anyway, since the width is part of RowKey
+    for (auto& surface : rowSurfaces_) surface->resize(w_, signalHeight_);
     staticLayer_.surface = Surface::MakeRecording(w_, h_);
     waveformLayer_.surface = Surface::MakeRecording(w_, h_);
     overlayLayer_.surface = Surface::MakeRecording(w_, h_);
@@ -192,11 +475,12 @@ void WaveformViewer::updateStaticLayer() {
     auto* c = staticLayer_.surface->canvas();
     staticLayer_.surface->beginFrame();
     c->fillRect({0, 0, f32(w_), f32(h_)}, {32, 32, 32, 255});
-    drawTimeScale(c);
+    drawTimeScale(c, {0, 0, f32(w_), f32(h_)});
     drawSignalNames(c);
     staticLayer_.surface->endFrame();
     staticLayer_.recording = staticLayer_.surface->takeRecording();
     staticLayer_.dirty = false;
+    culledOps_.staticLayer = staticLayer_.recording->culledOps();
 }
 
 void WaveformViewer::updateWaveformLayer() {
@@ -205,17 +489,329 @@ void WaveformViewer::updateWaveformLayer() {
     waveformLayer_.surface->beginFrame();
     c->save();
     c->clipRect({f32(nameWidth_), 0, f32(w_ - nameWidth_), f32(h_)});
+    i32 end = firstRow_ + visibleRowCount();
+    recordStaleRows(firstRow_, end);
+    culledOps_.waveformLayer = 0;
+    for (i32 idx : staleRows_) culledOps_.waveformLayer += rowCache_[idx].recording->culledOps();
     i32 y = 30;
-    i32 idx = 0;
-    for (const auto& sig : data_->signals) {
-        drawSignal(c, sig, y, idx);
+    for (i32 idx = firstRow_; idx < end; ++idx) {
+        c->drawRecording(*rowCache_[idx].recording, {0, f32(y)});
         y += signalHeight_ + 5;
-        idx++;
     }
     c->restore();
     waveformLayer_.surface->endFrame();
     waveformLayer_.recording = waveformLayer_.surface->takeRecording();
     waveformLayer_.dirty = false;
+    culledOps_.waveformLayer += waveformLayer_.recording->culledOps();
+    
+    // Rows that scrolled out are re-recorded if they come back
+    for (auto it = rowCache_.begin(); it != rowCache_.end();) {
+        if (it->first < firstRow_ || it->first >= end) it = rowCache_.erase(it);
+        else ++it;
+    }
+}
+
+void WaveformViewer::recordStaleRows(i32 first, i32 end) {
+    staleRows_.clear();
+    staleEntries_.clear();
+    for (i32 idx = first; idx < end; ++idx) {
+        const Signal& sig = data_->signals[idx];
+        RowKey key = {timeOffset_, timeScale_, signalRadixForIndex(idx, sig),
+                      signalHeight_, nameWidth_, w_, sig.changes.size()};
+        auto& row = rowCache_[idx];
+        if (row.recording && row.key == key) continue;
+        row.key = key;
+        staleRows_.push_back(idx);
+        staleEntries_.push_back(&row);
+    }
+    rowsRecorded_ = i32(staleRows_.size());
+    
+    // Each worker records into its own surface and writes its row through
+    // staleEntries_: the map itself is not touched, so it is not raced on
+    i32 workers = recordPool_ ? recordPool_->size() : 1;
+    while (i32(rowSurfaces_.size()) < workers) {
+        rowSurfaces_.push_back(Surface::MakeRecording(w_, signalHeight_));
+    }
+    auto recordRow = [this](size_t i, i32 worker) {
+        i32 idx = staleRows_[i];
+        Surface* surface = rowSurfaces_[worker].get();
+        surface->beginFrame();
+        drawSignal(surface->canvas(), data_->signals[idx], 0, idx, f32(nameWidth_), f32(w_));
+        surface->endFrame();
+        staleEntries_[i]->recording = surface->takeRecording();
+    };
+    if (recordPool_) {
+        recordPool_->parallelFor(staleRows_.size(), recordRow);
+    } else {
+        for (size_t i = 0; i < staleRows_.size(); ++i) recordRow(i, 0);
+    }
+}
+
+void WaveformViewer::setRecordThreads(i32 threads) {
+    recordThreads_ = threads;
+    recordPool_.reset();
+    if (threads != 1) recordPool_ = std::make_unique<ThreadPool>(threads);
+    if (recordPool_ && recordPool_->size() == 1) recordPool_.reset();
+}
+
+void WaveformViewer::setScrollReuse(bool enabled) {
+    scrollReuse_ = enabled;
+    rasterBase_ = {};
+}
+
+void WaveformViewer::setColumnDecimation(bool enabled) {
+    if (enabled == columnDecimation_) return;
+    columnDecimation_ = enabled;
+    rowCache_.clear();
+    rasterBase_ = {};
+    needsRepaint_ = true;
+    waveformLayer_.dirty = true;
+}
+
+void WaveformViewer::paintRaster(Surface* target, Pixmap* pixels) {
+    ensureLayers();
+    loadVisibleSignals();
+    bool overlayChanged = overlayLayer_.dirty;
+    if (overlayLayer_.dirty) updateOverlayLayer();
+    
+    RasterBase& base = rasterBase_;
+    const Pixmap* basePixels = base.surface ? base.surface->peekPixels() : nullptr;
+    if (!basePixels || basePixels->width() != w_ || basePixels->height() != h_ ||
+        basePixels->format() != pixels->format()) {
+        base.surface = Surface::MakeRaster(w_, h_, pixels->format());
+        base.valid = false;
+    }
+    base.surface->setGlyphCache(target->glyphCache());
+    bool sameView = base.valid && base.timeScale == timeScale_ && base.firstRow == firstRow_ &&
+                    base.selectedSignal == selectedSignal_ && base.dataVersion == dataVersion_ &&
+                    base.radixVersion == radixVersion_;
+    f64 shift = (base.timeOffset - timeOffset_) * timeScale_;
+    i32 dx = i32(std::lround(shift));
+    
+    bool baseChanged = true;
+    if (!sameView) {
+        redrawBase();
+    } else if (base.timeOffset != timeOffset_) {
+        // Only whole-pixel pans keep the retained pixels aligned
+        if (std::abs(shift - dx) < 1e-3 && std::abs(dx) < w_ - nameWidth_) panBase(dx);
+        else redrawBase();
+    } else {
+        pixelsRedrawn_ = 0;
+        baseChanged = false;
+    }
+    
+    // A target still holding the last frame over an unchanged base only
+    // needs the pixels under the old and the new overlay
+    GlyphCache* glyphs = target->glyphCache();
+    bool partial = !baseChanged && target->retainContents() && base.target == target &&
+                   base.glyphs == glyphs;
+    damage_.clear();
+    if (!partial) {
+        damage_.push_back({0, 0, f32(w_), f32(h_)});
+    } else if (overlayChanged) {
+        damage_ = base.overlayArea;
+    }
+    if (!partial || overlayChanged) {
+        if (overlayLayer_.recording) {
+            recordingArea(*overlayLayer_.recording, glyphs, w_, h_, base.overlayArea);
+        } else {
+            base.overlayArea.clear();
+        }
+        if (partial) {
+            for (const Rect& r : base.overlayArea) addDamage(damage_, r);
+        }
+    }
+    base.target = target;
+    base.glyphs = glyphs;
+    
+    const Pixmap& src = *base.surface->peekPixels();
+    for (const Rect& r : damage_) {
+        i32 x = i32(r.x), w = i32(r.w);
+        for (i32 y = i32(r.y); y < i32(r.y + r.h); ++y) {
+            std::memcpy(static_cast<u32*>(pixels->rowAddr(y)) + x,
+                        static_cast<const u32*>(src.rowAddr(y)) + x, size_t(w) * 4);
+        }
+        if (!overlayLayer_.recording) continue;
+        if (partial) {
+            target->submit(*overlayLayer_.recording, r);
+        } else {
+            target->submit(*overlayLayer_.recording);
+        }
+    }
+}
+
+void WaveformViewer::redrawBase() {
+    if (staticLayer_.dirty) updateStaticLayer();
+    if (waveformLayer_.dirty) updateWaveformLayer();
+    
+    RasterBase& base = rasterBase_;
+    if (staticLayer_.recording) base.surface->submit(*staticLayer_.recording);
+    if (waveformLayer_.recording) base.surface->submit(*waveformLayer_.recording);
+    
+    base.valid = true;
+    base.timeOffset = timeOffset_;
+    base.timeScale = timeScale_;
+    base.firstRow = firstRow_;
+    base.selectedSignal = selectedSignal_;
+    base.dataVersion = dataVersion_;
+    base.radixVersion = radixVersion_;
+    pixelsRedrawn_ = u64(w_) * u64(h_);
+}
+
+// Shifts the waveform area of the base by dx pixels, then redraws per band
+// the columns the shift cannot supply: the exposed strip, the divider
+// column, and segments whose drawing depends on where the edges fall
+// (clamped bus ends and their labels, LOD runs, name text spilling over)
+void WaveformViewer::panBase(i32 dx) {
+    RasterBase& base = rasterBase_;
+    Pixmap& pixels = *base.surface->peekPixels();
+    const i32 x0 = nameWidth_;
+    const i32 span = w_ - x0;
+    for (i32 y = 0; y < h_; ++y) {
+        u32* row = static_cast<u32*>(pixels.rowAddr(y)) + x0;
+        if (dx > 0) std::memmove(row + dx, row, size_t(span - dx) * 4);
+        else std::memmove(row, row - dx, size_t(span + dx) * 4);
+    }
+    
+    // Layer recordings stay stale; the next full redraw rebuilds them
+    staticLayer_.dirty = true;
+    waveformLayer_.dirty = true;
+    
+    Surface* recorder = waveformLayer_.surface.get();
+    Canvas* c = recorder->canvas();
+    recorder->beginFrame();
+    u64 redrawn = 0;
+    
+    auto redrawBand = [&](i32 top, i32 bottom, i32 leftEnd, i32 rightStart, i32 idx) {
+        bottom = std::min(bottom, h_);
+        if (bottom <= top) return;
+        leftEnd = std::clamp(leftEnd, x0 + 1, w_);
+        rightStart = std::clamp(rightStart, x0, w_);
+        if (rightStart <= leftEnd) { leftEnd = w_; rightStart = w_; }
+        for (i32 part = 0; part < 2; ++part) {
+            i32 a = part == 0 ? x0 : rightStart;
+            i32 b = part == 0 ? leftEnd : w_;
+            if (b <= a) continue;
+            Rect r = {f32(a), f32(top), f32(b - a), f32(bottom - top)};
+            c->save();
+            c->clipRect(r);
+            // Same order as the full frame: background, time scale,
+            // name column, then the waveform
+            c->fillRect(r, {32, 32, 32, 255});
+            drawTimeScale(c, r);
+            if (a == x0) c->drawLine({f32(x0), 0}, {f32(x0), f32(h_)}, {70, 70, 70, 255}, 1);
+            if (idx >= 0) {
+                const Signal& sig = data_->signals[idx];
+                if (5 + f32(sig.name.size()) * kMaxGlyphAdvance > r.x) {
+                    c->drawText({5, f32(top) + f32(signalHeight_) * 0.5f}, sig.name, {220, 220, 220, 255});
+                }
+                drawSignal(c, sig, top, idx, r.x, r.x + r.w);
+            }
+            c->restore();
+            redrawn += u64(b - a) * u64(bottom - top);
+        }
+    };
+    
+    // The old divider column moved along with everything else
+    i32 leftEnd = x0 + std::max(dx, 0) + 1;
+    i32 rightStart = w_ + std::min(dx, 0);
+    i32 labelReach = i32(std::ceil(timeLabelReach()));
+    redrawBand(0, 30, leftEnd + labelReach, rightStart - labelReach, -1);
+    
+    const i32 pitch = signalHeight_ + 5;
+    i32 y = 30;
+    i32 end = firstRow_ + visibleRowCount();
+    for (i32 idx = firstRow_; idx < end; ++idx, y += pitch) {
+        const Signal& sig = data_->signals[idx];
+        i32 rowLeft = leftEnd, rowRight = rightStart;
+        i32 nameReach = 5 + i32(f32(sig.name.size()) * kMaxGlyphAdvance);
+        if (nameReach > x0) rowLeft = std::max(rowLeft, nameReach + std::max(dx, 0));
+        panRedrawSpan(sig, idx, dx, &rowLeft, &rowRight);
+        redrawBand(y, y + pitch, rowLeft, rowRight, idx);
+    }
+    redrawBand(y, h_, leftEnd, rightStart, -1);
+    
+    recorder->endFrame();
+    auto recording = recorder->takeRecording();
+    if (recording) base.surface->submit(*recording);
+    base.timeOffset = timeOffset_;
+    pixelsRedrawn_ = redrawn;
+}
+
+// Widens a row's redraw columns for a pan of dx: leftEnd past everything
+// drawn differently because of the new or old left edge, rightStart before
+// the same for the right edge. Scalar raw rows are shift-invariant.
+void WaveformViewer::panRedrawSpan(const Signal& sig, i32 signalIndex, i32 dx,
+                                   i32* leftEnd, i32* rightStart) const {
+    if (sig.changes.empty()) return;
+    const bool bus = sig.width > 1;
+    const f64 xOff = nameWidth_;
+    const i32 edgeL = nameWidth_ + std::max(dx, 0);
+    const i32 edgeR = w_ + std::min(dx, 0);
+    auto timeAt = [&](f64 x) { return timeOffset_ + (x - xOff) / timeScale_; };
+    auto xAt = [&](f64 t) { return xOff + (t - timeOffset_) * timeScale_; };
+    i32 reach = bus ? i32(std::ceil(busLabelReach(sig, signalRadixForIndex(signalIndex, sig)))) : 0;
+    
+    i32 level = sig.lod.levelFor(1.0 / timeScale_);
+    if (level < 0) {
+        if (!bus) return;
+        // The segment cut by the left edge is clamped there, label included
+        f64 tL = timeAt(edgeL);
+        size_t i = tL < 0 ? 0 : sig.changes.upperBound(u64(std::floor(tL)));
+        i32 segEnd = i < sig.changes.size() ? i32(std::ceil(xAt(f64(sig.changes.time(i))))) + 1 : w_;
+        *leftEnd = std::max({*leftEnd, segEnd, edgeL + reach});
+        // The one cut by the right edge loses its right slant
+        f64 tR = timeAt(edgeR);
+        size_t j = tR <= 0 ? 0 : sig.changes.lowerBound(u64(std::ceil(tR)));
+        if (j > 0) *rightStart = std::min(*rightStart, i32(std::floor(xAt(f64(sig.changes.time(j - 1))))) - 1);
+        return;
+    }
+    
+    const auto& buckets = sig.lod.level(size_t(level));
+    const u32 shift = sig.lod.shift(size_t(level));
+    auto column = [&](const SignalLod::Bucket& b) {
+        return i32(std::floor(xAt(f64(b.index << shift))));
+    };
+    auto bucketAt = [&](f64 t) {
+        u64 index = t > 0 ? u64(t) >> shift : 0;
+        return std::lower_bound(buckets.begin(), buckets.end(), index,
+                                [](const SignalLod::Bucket& b, u64 v) { return b.index < v; });
+    };
+    
+    // Runs started at an edge column (where earlier buckets are clamped to)
+    // can differ until a column that is dense on its own, or one after a
+    // gap. Both the new and the old left edge start such runs.
+    auto resyncAfter = [&](i32 edge) {
+        i32 prev = edge, col = -1;
+        u64 count = 0;
+        for (auto it = bucketAt(timeAt(edge)); it != buckets.end(); ++it) {
+            i32 x = column(*it);
+            if (x <= edge) continue;
+            if (x != col) {
+                if (col >= 0 && (count > 1 || col > prev + 1)) return col;
+                if (x >= w_) return w_;
+                if (col >= 0) prev = col;
+                col = x;
+                count = 0;
+            }
+            count += it->count;
+        }
+        return col >= 0 && (count > 1 || col > prev + 1) ? col : w_;
+    };
+    i32 resync = std::max(resyncAfter(nameWidth_), resyncAfter(nameWidth_ + dx));
+    *leftEnd = std::max(*leftEnd, resync + 1 + reach);
+    
+    // Bus rows end in a flat segment from the last event column
+    if (bus) {
+        auto it = bucketAt(timeAt(edgeR));
+        i32 last = nameWidth_;
+        while (it != buckets.begin()) {
+            --it;
+            i32 x = column(*it);
+            if (x < edgeR) { last = std::max(x, nameWidth_); break; }
+        }
+        *rightStart = std::min(*rightStart, last - 1);
+    }
 }
 
 void WaveformViewer::updateOverlayLayer() {
@@ -227,13 +823,25 @@ void WaveformViewer::updateOverlayLayer() {
     overlayLayer_.surface->endFrame();
     overlayLayer_.recording = overlayLayer_.surface->takeRecording();
     overlayLayer_.dirty = false;
+    culledOps_.overlayLayer = overlayLayer_.recording->culledOps();
+}
+
+void WaveformViewer::setView(f64 timeOffset, f64 timeScale) {
+    if (timeScale <= 1e-10 || timeScale >= 1e10) return;
+    timeScale_ = timeScale;
+    timeOffset_ = timeOffset;
+    clampTimeOffset();
+    needsRepaint_ = true;
+    staticLayer_.dirty = true;
+    waveformLayer_.dirty = true;
+    overlayLayer_.dirty = true;
 }
 
 void WaveformViewer::mouseDown(i32 x, i32 y) {
     if (x < nameWidth_) {
         // Click in name area: select signal
         if (y < 30) return;
-        i32 idx = (y - 30) / (signalHeight_ + 5);
+        i32 idx = firstRow_ + (y - 30) / (signalHeight_ + 5);
         if (data_ && idx >= 0 && idx < static_cast<i32>(data_->signals.size())) {
             selectedSignal_ = idx;
             needsRepaint_ = true;
@@ -262,7 +870,11 @@ void WaveformViewer::mouseUp() {
 }
 
 void WaveformViewer::mouseWheel(i32 x, i32 delta) {
-    if (x < nameWidth_) return;
+    if (x < nameWidth_) {
+        // Name column scrolls rows; a no-op when they all fit
+        setScrollRow(firstRow_ + (delta > 0 ? -3 : 3));
+        return;
+    }
     
     f64 mouseTime = timeOffset_ + (x - nameWidth_) / timeScale_;
     f64 factor = delta > 0 ? 1.2 : 0.8;
@@ -298,15 +910,17 @@ void WaveformViewer::selectSignal(i32 index) {
         selectedSignal_ = index;
         needsRepaint_ = true;
         staticLayer_.dirty = true;
+        if (index >= 0) scrollToRow(index);
     }
 }
 
 bool WaveformViewer::jumpToNextEdge() {
     if (selectedSignal_ < 0 || !data_ || selectedSignal_ >= static_cast<i32>(data_->signals.size())) return false;
+    data_->ensureLoaded(size_t(selectedSignal_));
     const auto& sig = data_->signals[selectedSignal_];
     i32 idx = findNextEdgeIndex(sig, cursorTime_);
     if (idx >= 0 && idx < static_cast<i32>(sig.changes.size())) {
-        cursorTime_ = sig.changes[idx].time;
+        cursorTime_ = sig.changes.time(idx);
         needsRepaint_ = true;
         overlayLayer_.dirty = true;
         return true;
@@ -316,10 +930,11 @@ bool WaveformViewer::jumpToNextEdge() {
 
 bool WaveformViewer::jumpToPrevEdge() {
     if (selectedSignal_ < 0 || !data_ || selectedSignal_ >= static_cast<i32>(data_->signals.size())) return false;
+    data_->ensureLoaded(size_t(selectedSignal_));
     const auto& sig = data_->signals[selectedSignal_];
     i32 idx = findPrevEdgeIndex(sig, cursorTime_);
     if (idx >= 0 && idx < static_cast<i32>(sig.changes.size())) {
-        cursorTime_ = sig.changes[idx].time;
+        cursorTime_ = sig.changes.time(idx);
         needsRepaint_ = true;
         overlayLayer_.dirty = true;
         return true;
@@ -331,6 +946,7 @@ void WaveformViewer::setSignalRadix(i32 signalIndex, Radix radix) {
     if (!data_) return;
     if (signalIndex < 0 || signalIndex >= static_cast<i32>(signalRadix_.size())) return;
     signalRadix_[signalIndex] = radix;
+    radixVersion_++;
     needsRepaint_ = true;
     waveformLayer_.dirty = true;
     overlayLayer_.dirty = true;
@@ -351,6 +967,7 @@ void WaveformViewer::keyPress(i32 keycode) {
                 selectedSignal_--;
                 needsRepaint_ = true;
                 staticLayer_.dirty = true;
+                scrollToRow(selectedSignal_);
             }
             break;
         case 116: // Down arrow
@@ -358,6 +975,7 @@ void WaveformViewer::keyPress(i32 keycode) {
                 selectedSignal_++;
                 needsRepaint_ = true;
                 staticLayer_.dirty = true;
+                scrollToRow(selectedSignal_);
             }
             break;
     }
@@ -372,35 +990,26 @@ void WaveformViewer::clampTimeOffset() {
 }
 
 i32 WaveformViewer::findNextEdgeIndex(const Signal& sig, f64 time) {
-    for (size_t i = 0; i < sig.changes.size(); ++i) {
-        if (sig.changes[i].time > time) {
-            return static_cast<i32>(i);
-        }
-    }
-    return -1;
+    // Change times are integral, so "> time" is "> floor(time)"
+    size_t i = time < 0 ? 0 : sig.changes.upperBound(u64(std::floor(time)));
+    return i < sig.changes.size() ? static_cast<i32>(i) : -1;
 }
 
 i32 WaveformViewer::findPrevEdgeIndex(const Signal& sig, f64 time) {
-    for (size_t i = sig.changes.size(); i > 0; --i) {
-        if (sig.changes[i - 1].time < time) {
-            return static_cast<i32>(i - 1);
-        }
-    }
-    return -1;
+    if (time <= 0) return -1;
+    size_t i = sig.changes.lowerBound(u64(std::ceil(time)));
+    return static_cast<i32>(i) - 1;
 }
 
-u64 WaveformViewer::getValueAtTime(const Signal& sig, f64 time) {
+u64 WaveformViewer::getValueAtTime(const Signal& sig, f64 time, size_t* hint) {
     if (sig.changes.empty()) return 0;
-    
-    u64 value = sig.changes[0].value;
-    for (const auto& change : sig.changes) {
-        if (change.time <= time) {
-            value = change.value;
-        } else {
-            break;
-        }
+    size_t i = 0;
+    if (time >= 0) {
+        u64 t = u64(std::floor(time));
+        i = hint ? sig.changes.upperBound(t, *hint) : sig.changes.upperBound(t);
     }
-    return value;
+    if (hint) *hint = i;
+    return sig.changes.value(i > 0 ? i - 1 : 0);
 }
 
 std::string WaveformViewer::formatValue(u64 value, i32 width, Radix radix) {
@@ -438,4 +1047,201 @@ Radix WaveformViewer::signalRadixForIndex(i32 index, const Signal& sig) const {
     return sig.radix;
 }
 
+// Everything a layer rebuild reads from the viewer
+struct WaveformViewer::ViewState {
+    WaveformData* data;
+    u64 dataVersion;
+    i32 w, h;
+    f64 timeOffset, timeScale;
+    i32 firstRow;
+    f64 cursorTime;
+    i32 selectedSignal;
+    std::vector<Radix> signalRadix;
+    bool columnDecimation;
+    i32 recordThreads;
+};
+
+// Background thread that rebuilds layers on a private viewer configured
+// from a ViewState snapshot. Only the newest job is kept; a job is dropped
+// between layers as soon as a newer one is posted.
+struct WaveformViewer::AsyncBuilder {
+    struct Job {
+        u64 generation;
+        ViewState state;
+        bool layers[3];
+    };
+    struct Result {
+        u64 generation = 0;
+        f64 timeOffset = 0, timeScale = 0;
+        std::unique_ptr<Recording> layers[3];
+    };
+    
+    WaveformViewer shadow;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::unique_ptr<Job> job;
+    Result result;
+    bool hasResult = false;
+    bool stop = false;
+    std::atomic<u64> latest{0};
+    std::atomic<bool>* ready = nullptr;
+    
+    void run() {
+        for (;;) {
+            std::unique_ptr<Job> current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stop || job; });
+                if (stop) return;
+                current = std::move(job);
+            }
+            
+            shadow.applyState(current->state);
+            if (shadow.data_) shadow.loadVisibleSignals();
+            Layer* layers[3] = {&shadow.staticLayer_, &shadow.waveformLayer_, &shadow.overlayLayer_};
+            std::unique_ptr<Recording> built[3];
+            bool abandoned = false;
+            for (i32 l = 0; l < 3 && !abandoned; ++l) {
+                if (!current->layers[l] || !shadow.data_) continue;
+                if (latest.load() != current->generation) abandoned = true;
+                else {
+                    shadow.ensureLayers();
+                    if (l == 0) shadow.updateStaticLayer();
+                    if (l == 1) shadow.updateWaveformLayer();
+                    if (l == 2) shadow.updateOverlayLayer();
+                    built[l] = std::move(layers[l]->recording);
+                }
+            }
+            if (abandoned) continue;
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            result.generation = current->generation;
+            result.timeOffset = current->state.timeOffset;
+            result.timeScale = current->state.timeScale;
+            for (i32 l = 0; l < 3; ++l) {
+                if (built[l]) result.layers[l] = std::move(built[l]);
+            }
+            hasResult = true;
+            ready->store(true);
+            done.notify_all();
+        }
+    }
+};
+
+void WaveformViewer::setAsync(bool enabled) {
+    if (enabled == (async_ != nullptr)) return;
+    if (!enabled) {
+        {
+            std::lock_guard<std::mutex> lock(async_->mutex);
+            async_->stop = true;
+        }
+        async_->wake.notify_all();
+        async_->thread.join();
+        async_.reset();
+        asyncReady_ = false;
+    } else {
+        async_ = std::make_unique<AsyncBuilder>();
+        async_->ready = &asyncReady_;
+        AsyncBuilder* builder = async_.get();
+        async_->thread = std::thread([builder]() { builder->run(); });
+    }
+    for (Layer* layer : {&staticLayer_, &waveformLayer_, &overlayLayer_}) {
+        layer->dirty = true;
+        layer->pending = false;
+        layer->recording.reset();
+    }
+}
+
+bool WaveformViewer::rebuildPending() const {
+    return staticLayer_.pending || waveformLayer_.pending || overlayLayer_.pending;
+}
+
+WaveformViewer::ViewState WaveformViewer::captureState() const {
+    return {data_, dataVersion_, w_, h_, timeOffset_, timeScale_, firstRow_,
+            cursorTime_, selectedSignal_, signalRadix_, columnDecimation_, recordThreads_};
+}
+
+void WaveformViewer::applyState(const ViewState& state) {
+    if (state.w != w_ || state.h != h_) setSize(state.w, state.h);
+    if (state.recordThreads != recordThreads_) setRecordThreads(state.recordThreads);
+    if (state.dataVersion != dataVersion_ || state.data != data_) {
+        setData(state.data);
+        dataVersion_ = state.dataVersion;
+    }
+    timeOffset_ = state.timeOffset;
+    timeScale_ = state.timeScale;
+    firstRow_ = state.firstRow;
+    cursorTime_ = state.cursorTime;
+    selectedSignal_ = state.selectedSignal;
+    signalRadix_ = state.signalRadix;
+    setColumnDecimation(state.columnDecimation);
+}
+
+void WaveformViewer::paintAsync(Surface* target) {
+    Layer* layers[3] = {&staticLayer_, &waveformLayer_, &overlayLayer_};
+    
+    if (staticLayer_.dirty || waveformLayer_.dirty || overlayLayer_.dirty) {
+        auto job = std::make_unique<AsyncBuilder::Job>();
+        job->generation = ++generation_;
+        job->state = captureState();
+        for (i32 l = 0; l < 3; ++l) {
+            // Layers of an unfinished older job are rebuilt by this one
+            job->layers[l] = layers[l]->dirty || layers[l]->pending;
+            layers[l]->pending = job->layers[l];
+            layers[l]->dirty = false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(async_->mutex);
+            async_->latest = job->generation;
+            async_->job = std::move(job);
+        }
+        async_->wake.notify_one();
+    }
+    
+    {
+        std::unique_lock<std::mutex> lock(async_->mutex);
+        if (rebuildPending()) {
+            auto deadline = std::chrono::steady_clock::now() +
+                            std::chrono::duration<f64, std::milli>(frameBudgetMs_);
+            async_->done.wait_until(lock, deadline, [this]() {
+                return async_->hasResult && async_->result.generation == generation_;
+            });
+        }
+        if (async_->hasResult) {
+            auto& result = async_->result;
+            for (i32 l = 0; l < 3; ++l) {
+                if (!result.layers[l]) continue;
+                layers[l]->recording = std::move(result.layers[l]);
+                layers[l]->timeOffset = result.timeOffset;
+                layers[l]->timeScale = result.timeScale;
+                if (result.generation == generation_) layers[l]->pending = false;
+            }
+            async_->hasResult = false;
+            asyncReady_ = false;
+        }
+    }
+    
+    if (staticLayer_.recording) target->submit(*staticLayer_.recording);
+    if (waveformLayer_.recording) {
+        const Layer& wave = waveformLayer_;
+        f32 dx = f32((wave.timeOffset - timeOffset_) * timeScale_);
+        if (wave.timeScale == timeScale_ && dx != 0) {
+            // Preview: the last waveform shifted to the current offset, kept
+            // out of the name column. The static layer is not shifted, so
+            // the time ticks stay at the old offset until the rebuild lands;
+            // they share a recording with the names, which must not move
+            Recorder shifted;
+            shifted.setClip({f32(nameWidth_), 0, f32(w_ - nameWidth_), f32(h_)});
+            shifted.append(*wave.recording, {dx, 0});
+            shifted.clearClip();
+            target->submit(*shifted.finish());
+        } else {
+            target->submit(*wave.recording);
+        }
+    }
+    if (overlayLayer_.recording) target->submit(*overlayLayer_.recording);
+}
+
 }
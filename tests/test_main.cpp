@@ -1,17 +1,39 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include "vcd_parser.hpp"
+#include "waveform_cache.hpp"
 #include "waveform_viewer.hpp"
+#include "glyph_cache.hpp"
+#include "recording_file.hpp"
+#include "raster_device.hpp"
+#include "span_kernels.hpp"
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
 
 using namespace wv;
 
 class VcdParserTest : public ::testing::Test {
 protected:
+    // A new dump starts without the .wvc cache of the one before it
     void writeVcd(const char* content) {
+        std::remove("/tmp/test.vcd.wvc");
         std::ofstream f("/tmp/test.vcd");
         f << content;
     }
+
+    // Parses the text every time, for tests comparing parser paths
+    static ParseOptions textOnly(i32 threads = 1, ParseMode mode = ParseMode::Mapped) {
+        ParseOptions options;
+        options.threads = threads;
+        options.mode = mode;
+        options.cache = false;
+        return options;
+    }
 };
 
 TEST_F(VcdParserTest, ParsesTimescale) {
@@ -142,3 +164,1418 @@ TEST_F(WaveformViewerTest, MouseDownInNameAreaNoDrag) {
     viewer.mouseMove(100, 100);
     EXPECT_FALSE(viewer.needsRepaint());
 }
+
+TEST_F(WaveformViewerTest, ReusesCachedRowRecordings) {
+    for (int i = 0; i < 40; ++i) {
+        data.signals.push_back({"b" + std::to_string(i), "x", 8, {{0, 1}, {50, 2}}});
+    }
+    viewer.setData(&data);
+    auto paint = [this]() {
+        auto target = Surface::MakeRecording(800, 600);
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+        return target->takeRecording()->ops().size();
+    };
+    size_t ops = paint();
+    const i32 rows = viewer.rowsRecorded();
+    EXPECT_EQ(rows, (600 - 30 + 34) / 35);
+
+    viewer.setSignalRadix(3, Radix::Decimal);
+    EXPECT_EQ(paint(), ops);
+    EXPECT_EQ(viewer.rowsRecorded(), 1);
+
+    viewer.setScrollRow(1);
+    paint();
+    EXPECT_EQ(viewer.rowsRecorded(), 1);
+
+    viewer.setView(10, viewer.timeScale());
+    paint();
+    EXPECT_EQ(viewer.rowsRecorded(), rows);
+}
+
+TEST_F(WaveformViewerTest, ParallelRowRecordingMatchesSerial) {
+    for (int i = 0; i < 40; ++i) {
+        Signal sig{"b" + std::to_string(i), "x", 8, {}};
+        for (u64 t = 0; t < 100; t += 1 + i % 5) sig.changes.push_back({t, t * 7 + i});
+        data.signals.push_back(std::move(sig));
+    }
+    auto record = [this](i32 threads) {
+        WaveformViewer v;
+        v.setSize(800, 600);
+        v.setData(&data);
+        v.setRecordThreads(threads);
+        auto target = Surface::MakeRecording(800, 600);
+        target->beginFrame();
+        v.paint(target.get());
+        target->endFrame();
+        return target->takeRecording();
+    };
+    auto serial = record(1);
+    auto parallel = record(4);
+    ASSERT_EQ(serial->ops().size(), parallel->ops().size());
+    for (size_t i = 0; i < serial->ops().size(); ++i) {
+        EXPECT_EQ(std::memcmp(&serial->ops()[i], &parallel->ops()[i], sizeof(CompactDrawOp)), 0) << i;
+    }
+}
+
+TEST_F(WaveformViewerTest, AsyncRebuildMatchesSync) {
+    for (int i = 0; i < 20; ++i) {
+        Signal sig{"b" + std::to_string(i), "x", 8, {}};
+        for (u64 t = 0; t < 100; t += 1 + i % 5) sig.changes.push_back({t, t * 7 + i});
+        data.signals.push_back(std::move(sig));
+    }
+    auto frame = [](WaveformViewer& v) {
+        auto target = Surface::MakeRecording(800, 600);
+        target->beginFrame();
+        v.paint(target.get());
+        target->endFrame();
+        return target->takeRecording();
+    };
+    WaveformViewer sync;
+    sync.setSize(800, 600);
+    sync.setData(&data);
+    sync.setView(12, 9.0);
+    sync.setCursorTime(40);
+    auto expected = frame(sync);
+
+    WaveformViewer async;
+    async.setSize(800, 600);
+    async.setData(&data);
+    async.setAsync(true);
+    async.setFrameBudget(0);
+    // Several generations in a row; only the last one has to land
+    for (int i = 0; i < 5; ++i) {
+        async.setView(i * 3, 9.0);
+        frame(async);
+    }
+    async.setCursorTime(40);
+    frame(async);
+    EXPECT_GE(async.generation(), 6u);
+
+    async.setFrameBudget(10000);
+    std::unique_ptr<Recording> got;
+    for (int i = 0; i < 100 && (async.rebuildPending() || !got); ++i) got = frame(async);
+    EXPECT_FALSE(async.rebuildPending());
+    ASSERT_EQ(got->ops().size(), expected->ops().size());
+    for (size_t i = 0; i < got->ops().size(); ++i) {
+        EXPECT_EQ(got->ops()[i].type, expected->ops()[i].type) << i;
+    }
+}
+
+TEST(ThreadPoolTest, RunsEveryIndexOnce) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4);
+    std::vector<std::atomic<int>> hits(1000);
+    for (int round = 0; round < 3; ++round) {
+        pool.parallelFor(hits.size(), [&](size_t i, i32 worker) {
+            EXPECT_GE(worker, 0);
+            EXPECT_LT(worker, 4);
+            hits[i]++;
+        });
+    }
+    for (auto& h : hits) EXPECT_EQ(h.load(), 3);
+}
+
+TEST_F(WaveformViewerTest, RecordsOnlyVisibleRows) {
+    auto countOps = [](WaveformViewer& v, i32 w, i32 h) {
+        auto target = Surface::MakeRecording(w, h);
+        target->beginFrame();
+        v.paint(target.get());
+        target->endFrame();
+        return target->takeRecording()->ops().size();
+    };
+    size_t small = countOps(viewer, 800, 600);
+
+    for (int i = 0; i < 10000; ++i) {
+        data.signals.push_back({"s" + std::to_string(i), "x", 1, {{0, 0}, {10, 1}, {20, 0}}});
+    }
+    viewer.setData(&data);
+    size_t large = countOps(viewer, 800, 600);
+    EXPECT_LT(large, small * 20 + 200);
+
+    viewer.clearRepaintFlag();
+    viewer.mouseWheel(50, -1);
+    EXPECT_TRUE(viewer.needsRepaint());
+    EXPECT_EQ(viewer.scrollRow(), 3);
+    viewer.setScrollRow(1000000);
+    EXPECT_EQ(viewer.scrollRow(), 10001 - (600 - 30) / 35);
+    EXPECT_LE(countOps(viewer, 800, 600), large);
+
+    viewer.mouseDown(50, 30);
+    EXPECT_EQ(viewer.selectedSignal(), viewer.scrollRow());
+    viewer.selectSignal(0);
+    EXPECT_EQ(viewer.scrollRow(), 0);
+}
+
+TEST_F(WaveformViewerTest, RasterPanMatchesFullRedraw) {
+    Signal bus{"a_bus_name_longer_than_the_column", "\"", 16, {}};
+    Signal dense{"dense", "#", 1, {}};
+    Signal lodBus{"lod_bus", "$", 8, {}};
+    for (u64 t = 0; t < 40000; t += 7 + (t * 13) % 90) bus.changes.push_back({t, t * 2654435761u & 0xFFFF});
+    for (u64 t = 0; t < 40000; t += 1 + (t / 50) % 4) dense.changes.push_back({t, (t / 3) & 1});
+    for (u64 t = 0; t < 40000; t += (t / 200) % 2 ? 1 : 40) lodBus.changes.push_back({t, t & 0xFF});
+    dense.lod.build(dense.changes);
+    lodBus.lod.build(lodBus.changes);
+    data.endTime = 40000;
+    data.signals.push_back(std::move(bus));
+    data.signals.push_back(std::move(dense));
+    data.signals.push_back(std::move(lodBus));
+
+    GlyphCache glyphs;
+    bool font = glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f);
+    auto makeTarget = [&]() {
+        auto target = Surface::MakeRaster(400, 200);
+        if (font) target->setGlyphCache(&glyphs);
+        return target;
+    };
+    auto reuseTarget = makeTarget();
+    auto fullTarget = makeTarget();
+    WaveformViewer full;
+    full.setSize(400, 200);
+    full.setData(&data);
+    viewer.setSize(400, 200);
+    viewer.setData(&data);
+    viewer.setScrollReuse(true);
+
+    // Power-of-two scales keep pixel positions exact across shifts
+    for (f64 scale : {2.0, 0.5, 1.0 / 32}) {
+        f64 offset = 1000;
+        for (i32 dx : {0, 4, 4, -9, 37, -1, 120, -200, 3}) {
+            offset -= dx / scale;
+            viewer.setView(offset, scale);
+            full.setView(offset, scale);
+            reuseTarget->beginFrame();
+            viewer.paint(reuseTarget.get());
+            fullTarget->beginFrame();
+            full.paint(fullTarget.get());
+            if (dx == 4) {
+                EXPECT_LT(viewer.pixelsRedrawn(), 400u * 200u / 2);
+            }
+
+            const Pixmap& a = *reuseTarget->peekPixels();
+            const Pixmap& b = *fullTarget->peekPixels();
+            i32 mismatches = 0;
+            for (i32 y = 0; y < 200; ++y) {
+                for (i32 x = 0; x < 400; ++x) {
+                    if (a.addr32()[y * 400 + x] != b.addr32()[y * 400 + x] && mismatches++ < 3) {
+                        ADD_FAILURE() << "scale " << scale << " dx " << dx << " at " << x << "," << y;
+                    }
+                }
+            }
+            EXPECT_EQ(mismatches, 0);
+        }
+    }
+}
+
+TEST_F(VcdParserTest, MappedMatchesStream) {
+    writeVcd(R"(
+$timescale 10ns $end
+$scope module top $end
+$var wire 1 ! clk $end
+$scope module sub $end
+$var wire 4 "# nib [3:0] $end
+$upscope $end
+$var wire 1 % rst $end
+$upscope $end
+$enddefinitions $end
+#0
+$dumpvars
+0!
+bxz01 "#
+x%
+$end
+#5
+1!
+b1111 "#
+#12
+0!
+1%
+b0 "#
+)");
+
+    VcdParser stream;
+    VcdParser mapped;
+    ASSERT_TRUE(stream.parse("/tmp/test.vcd", textOnly(1, ParseMode::Stream)));
+    ASSERT_TRUE(mapped.parse("/tmp/test.vcd", textOnly(1, ParseMode::Mapped)));
+
+    const auto& a = stream.data();
+    const auto& b = mapped.data();
+    EXPECT_EQ(a.timescale, 10000);
+    EXPECT_EQ(a.timescale, b.timescale);
+    EXPECT_EQ(a.endTime, b.endTime);
+    ASSERT_EQ(a.signals.size(), 3);
+    ASSERT_EQ(a.signals.size(), b.signals.size());
+    EXPECT_EQ(b.signals[1].name, "top.sub.nib");
+    for (size_t i = 0; i < a.signals.size(); ++i) {
+        EXPECT_EQ(a.signals[i].name, b.signals[i].name);
+        EXPECT_EQ(a.signals[i].id, b.signals[i].id);
+        EXPECT_EQ(a.signals[i].width, b.signals[i].width);
+        ASSERT_EQ(a.signals[i].changes.size(), b.signals[i].changes.size());
+        for (size_t j = 0; j < a.signals[i].changes.size(); ++j) {
+            EXPECT_EQ(a.signals[i].changes[j].time, b.signals[i].changes[j].time);
+            EXPECT_EQ(a.signals[i].changes[j].value, b.signals[i].changes[j].value);
+        }
+    }
+    ASSERT_EQ(b.signals[1].changes.size(), 3);
+    EXPECT_EQ(b.signals[1].changes[0].value, 0x1);
+    EXPECT_EQ(b.signals[1].changes[1].value, 0xF);
+}
+
+TEST_F(VcdParserTest, MappedHandlesEmptyFile) {
+    writeVcd("");
+    VcdParser parser;
+    ASSERT_TRUE(parser.parse("/tmp/test.vcd", ParseMode::Mapped));
+    EXPECT_TRUE(parser.data().signals.empty());
+    EXPECT_EQ(parser.data().endTime, 0);
+}
+
+TEST_F(VcdParserTest, ParallelMatchesSingleThreaded) {
+    {
+        std::ofstream f("/tmp/test.vcd");
+        f << "$timescale 1ps $end\n$scope module top $end\n";
+        f << "$var wire 1 ! a $end\n$var wire 1 \" b $end\n$var wire 16 # c [15:0] $end\n";
+        f << "$upscope $end\n$enddefinitions $end\n";
+        // Large enough (> 1 MB) to take the chunked path
+        for (int t = 0; t < 60000; ++t) {
+            f << '#' << t * 3 << '\n';
+            f << ((t & 1) ? '1' : '0') << "!\n";
+            if (t % 3 == 0) f << ((t & 2) ? '1' : '0') << "\"\n";
+            f << 'b';
+            for (int bit = 15; bit >= 0; --bit) f << (((t * 7) >> bit) & 1);
+            f << " #\n";
+        }
+    }
+
+    VcdParser single;
+    VcdParser parallel;
+    ASSERT_TRUE(single.parse("/tmp/test.vcd", textOnly(1)));
+    ASSERT_TRUE(parallel.parse("/tmp/test.vcd", textOnly(4)));
+
+    const auto& a = single.data();
+    const auto& b = parallel.data();
+    EXPECT_EQ(a.endTime, 59999u * 3);
+    EXPECT_EQ(a.endTime, b.endTime);
+    ASSERT_EQ(a.signals.size(), b.signals.size());
+    for (size_t i = 0; i < a.signals.size(); ++i) {
+        ASSERT_EQ(a.signals[i].changes.size(), b.signals[i].changes.size());
+        for (size_t j = 0; j < a.signals[i].changes.size(); ++j) {
+            ASSERT_EQ(a.signals[i].changes[j].time, b.signals[i].changes[j].time);
+            ASSERT_EQ(a.signals[i].changes[j].value, b.signals[i].changes[j].value);
+        }
+    }
+    EXPECT_EQ(b.signals[0].changes.size(), 60000u);
+    EXPECT_EQ(b.signals[1].changes.size(), 20000u);
+}
+
+TEST(VcdIdTableTest, DecodesShortAndLongIds) {
+    std::vector<Signal> signals;
+    for (const char* id : {"!", "~", "!!", "~~~", "a\x7f", "long", "z"}) {
+        signals.push_back({id, id, 1, {}});
+    }
+    signals.push_back({"alias", "z", 1, {}});
+
+    VcdIdTable table;
+    table.build(signals);
+    EXPECT_EQ(table.find("!"), 0u);
+    EXPECT_EQ(table.find("~"), 1u);
+    EXPECT_EQ(table.find("!!"), 2u);
+    EXPECT_EQ(table.find("~~~"), 3u);
+    EXPECT_EQ(table.find("a\x7f"), 4u);
+    EXPECT_EQ(table.find("long"), 5u);
+    EXPECT_EQ(table.find("z"), 7u);  // last declaration wins
+    EXPECT_EQ(table.find("\""), VcdIdTable::kNotFound);
+    EXPECT_EQ(table.find("~~~~"), VcdIdTable::kNotFound);
+    EXPECT_EQ(table.find(""), VcdIdTable::kNotFound);
+}
+
+TEST(SignalChangesTest, PacksScalarValuesUntilWider) {
+    SignalChanges changes;
+    for (u64 i = 0; i < 200; ++i) {
+        changes.push_back({i * 10, i & 1});
+    }
+    EXPECT_TRUE(changes.packed());
+    EXPECT_EQ(changes.valueWords().size(), 4u);
+    EXPECT_EQ(changes.value(0), 0u);
+    EXPECT_EQ(changes.value(129), 1u);
+    EXPECT_EQ(changes.time(199), 1990u);
+
+    changes.push_back({2000, 0xAB});
+    EXPECT_FALSE(changes.packed());
+    ASSERT_EQ(changes.size(), 201u);
+    for (u64 i = 0; i < 200; ++i) {
+        EXPECT_EQ(changes[i].value, i & 1);
+    }
+    EXPECT_EQ(changes.back().value, 0xABu);
+}
+
+TEST(SignalChangesTest, ScalarStorageIsAboutHalfOfRowLayout) {
+    SignalChanges changes;
+    const size_t n = 100000;
+    changes.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        changes.push_back({i, i & 1});
+    }
+    EXPECT_LT(changes.memoryBytes(), n * sizeof(SignalChange) * 6 / 10);
+}
+
+TEST(SignalChangesTest, CompressedMatchesFlat) {
+    SignalChanges flat;
+    u64 t = 5;
+    for (u64 i = 0; i < 1000; ++i) {
+        t += (i % 7 == 0) ? 100000 : 3;
+        flat.push_back({t, i * 3});
+    }
+    SignalChanges compressed = flat;
+    compressed.compress();
+    EXPECT_TRUE(compressed.compressed());
+    EXPECT_LT(compressed.memoryBytes(), flat.memoryBytes());
+
+    ASSERT_EQ(compressed.size(), flat.size());
+    size_t i = 0;
+    for (auto it = compressed.begin(); it != compressed.end(); ++it, ++i) {
+        EXPECT_EQ(it.time(), flat.time(i));
+        EXPECT_EQ(it.value(), flat.value(i));
+    }
+    for (size_t j : {size_t(0), size_t(127), size_t(128), size_t(999)}) {
+        EXPECT_EQ(compressed.time(j), flat.time(j));
+        EXPECT_EQ(compressed.seek(j).time(), flat.time(j));
+        EXPECT_EQ(compressed.lowerBound(flat.time(j)), j);
+        EXPECT_EQ(compressed.upperBound(flat.time(j)), j + 1);
+        EXPECT_EQ(compressed.lowerBound(flat.time(j) - 1), j);
+    }
+    EXPECT_EQ(compressed.lowerBound(0), 0u);
+    EXPECT_EQ(compressed.lowerBound(flat.back().time + 1), flat.size());
+
+    compressed.push_back({t + 1, 7});
+    EXPECT_EQ(compressed.back().time, t + 1);
+    EXPECT_EQ(compressed.time(1000), t + 1);
+}
+
+TEST_F(VcdParserTest, CompressedParseMatchesFlat) {
+    writeVcd(R"(
+$timescale 1ns $end
+$var wire 1 ! clk $end
+$var wire 8 " data $end
+$enddefinitions $end
+#0
+0!
+b00000000 "
+#10
+1!
+#20
+0!
+b10100101 "
+#30
+1!
+)");
+    VcdParser flat;
+    ASSERT_TRUE(flat.parse("/tmp/test.vcd", textOnly()));
+    ParseOptions options = textOnly();
+    options.compress = true;
+    VcdParser compressed;
+    ASSERT_TRUE(compressed.parse("/tmp/test.vcd", options));
+
+    const auto& a = flat.data();
+    const auto& b = compressed.data();
+    ASSERT_EQ(a.signals.size(), b.signals.size());
+    for (size_t s = 0; s < a.signals.size(); ++s) {
+        EXPECT_TRUE(b.signals[s].changes.compressed());
+        ASSERT_EQ(a.signals[s].changes.size(), b.signals[s].changes.size());
+        for (size_t i = 0; i < a.signals[s].changes.size(); ++i) {
+            EXPECT_EQ(a.signals[s].changes[i].time, b.signals[s].changes[i].time);
+            EXPECT_EQ(a.signals[s].changes[i].value, b.signals[s].changes[i].value);
+        }
+    }
+}
+
+TEST(SignalChangesTest, HintedUpperBoundMatchesPlain) {
+    SignalChanges changes;
+    for (u64 i = 0; i < 5000; ++i) {
+        changes.push_back({i * 10 + (i % 3), i & 1});
+    }
+    u64 state = 1;
+    for (int k = 0; k < 2000; ++k) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        u64 t = (state >> 20) % 51000;
+        size_t hint = size_t((state >> 8) % 5100);
+        EXPECT_EQ(changes.upperBound(t, hint), changes.upperBound(t)) << t << " " << hint;
+    }
+    EXPECT_EQ(changes.upperBound(0, 5000), changes.upperBound(0));
+    EXPECT_EQ(changes.upperBound(~u64(0), 0), changes.size());
+}
+
+TEST(SignalLodTest, SummarizesBuckets) {
+    SignalChanges changes;
+    for (u64 i = 0; i < 4096; ++i) {
+        changes.push_back({i * 4, (i % 3 == 0) ? 5 : i & 0xF});
+    }
+    SignalLod lod;
+    lod.build(changes);
+    ASSERT_FALSE(lod.empty());
+    EXPECT_EQ(lod.level(lod.levelCount() - 1).size(), 1u);
+
+    u64 total = 0;
+    for (const auto& b : lod.level(0)) total += b.count;
+    EXPECT_EQ(total, changes.size());
+
+    const auto& top = lod.level(lod.levelCount() - 1)[0];
+    EXPECT_EQ(top.count, changes.size());
+    EXPECT_EQ(top.first, changes.front().value);
+    EXPECT_EQ(top.last, changes.back().value);
+    EXPECT_EQ(top.min, 0u);
+    EXPECT_EQ(top.max, 0xFu);
+
+    EXPECT_EQ(lod.levelFor(0.5), -1);
+    EXPECT_EQ(lod.levelFor(1e18), i32(lod.levelCount()) - 1);
+
+    SignalLod small;
+    small.build({{0, 0}, {10, 1}});
+    EXPECT_TRUE(small.empty());
+}
+
+TEST(SignalLodTest, ZoomedOutFrameCostIsBoundedByWidth) {
+    WaveformData data;
+    data.timescale = 1;
+    Signal clk{"clk", "!", 1, {}};
+    Signal bus{"bus", "\"", 8, {}};
+    for (u64 t = 0; t < 1000000; ++t) {
+        clk.changes.push_back({t, t & 1});
+        if (t % 3 == 0) bus.changes.push_back({t, t & 0xFF});
+    }
+    clk.lod.build(clk.changes);
+    bus.lod.build(bus.changes);
+    data.endTime = 1000000;
+    data.signals.push_back(std::move(clk));
+    data.signals.push_back(std::move(bus));
+
+    WaveformViewer viewer;
+    viewer.setSize(800, 200);
+    viewer.setData(&data);
+    auto target = Surface::MakeRecording(800, 200);
+    target->beginFrame();
+    viewer.paint(target.get());
+    target->endFrame();
+    auto recording = target->takeRecording();
+    ASSERT_TRUE(recording);
+    EXPECT_LT(recording->ops().size(), 4 * 800u);
+}
+
+TEST(SignalLodTest, RepeatedValuesDrawNoActivity) {
+    // Dense rewrites of the value held (as from a $dumpall) are not
+    // activity; the same rate of real changes is
+    auto fills = [](bool repeat) {
+        WaveformData data;
+        data.timescale = 1;
+        data.endTime = 100000;
+        Signal bus{"bus", "\"", 8, {}};
+        Signal bit{"bit", "!", 1, {}};
+        for (u64 t = 0; t < data.endTime; ++t) {
+            bus.changes.push_back({t, repeat ? 0x5A : t & 0xFF});
+            bit.changes.push_back({t, repeat ? 1 : t & 1});
+        }
+        bus.lod.build(bus.changes);
+        bit.lod.build(bit.changes);
+        data.signals.push_back(std::move(bus));
+        data.signals.push_back(std::move(bit));
+
+        WaveformViewer viewer;
+        viewer.setSize(800, 200);
+        viewer.setData(&data);
+        viewer.setView(0, 0.0068);
+        auto target = Surface::MakeRecording(800, 200);
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+        auto recording = target->takeRecording();
+        // Activity blocks are the only fills below the time scale
+        size_t n = 0;
+        for (const auto& op : recording->ops()) {
+            n += op.type == DrawOp::Type::FillRect && op.bounds.y > 30;
+        }
+        return n;
+    };
+    EXPECT_GT(fills(false), 0u);
+    EXPECT_EQ(fills(true), 0u);
+}
+
+TEST(SignalLodTest, BurstColumnsDrawOneEdgeEach) {
+    // Sparse toggles, so the LOD buckets are coarse, around bursts of one
+    // toggle per time unit; a short signal with repeated values has no LOD
+    WaveformData data;
+    data.timescale = 1;
+    data.endTime = 1000000;
+    Signal bursty{"bursty", "!", 1, {}};
+    for (u64 t = 0, n = 0; t < data.endTime; t += 9973, ++n) {
+        bursty.changes.push_back({t, n & 1});
+        if (n % 20 == 3) {
+            for (u64 b = 1; b < 5000; ++b) bursty.changes.push_back({t + b, (n + b) & 1});
+        }
+    }
+    Signal small{"small", "\"", 1, {}};
+    for (u64 t = 0; t < 200; ++t) small.changes.push_back({(t / 10) * 4000 + t % 10, (t / 3) & 1});
+    bursty.lod.build(bursty.changes);
+    small.lod.build(small.changes);
+    data.signals.push_back(std::move(bursty));
+    data.signals.push_back(std::move(small));
+
+    auto ops = [&](bool decimate, f64 offset, f64 scale) {
+        WaveformViewer viewer;
+        viewer.setSize(800, 200);
+        viewer.setData(&data);
+        viewer.setColumnDecimation(decimate);
+        viewer.setView(offset, scale);
+        auto target = Surface::MakeRecording(800, 200);
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+        return target->takeRecording();
+    };
+    auto pixels = [&](const Recording& recording) {
+        auto target = Surface::MakeRaster(800, 200);
+        target->beginFrame();
+        target->submit(recording);
+        const u32* px = target->peekPixels()->addr32();
+        return std::vector<u32>(px, px + 800 * 200);
+    };
+    for (auto [offset, scale] : {std::pair<f64, f64>{0, 0.01}, {59500.5, 0.013}, {60000, 0.0037}, {0, 0.3}}) {
+        auto naive = ops(false, offset, scale);
+        auto decimated = ops(true, offset, scale);
+        EXPECT_EQ(pixels(*decimated), pixels(*naive)) << "offset " << offset << " scale " << scale;
+        EXPECT_LE(decimated->ops().size(), naive->ops().size());
+        if (scale == 0.01) {
+            EXPECT_GT(naive->ops().size(), 8000u);
+            EXPECT_LT(decimated->ops().size(), 4 * 800u);
+        }
+    }
+}
+
+TEST_F(VcdParserTest, LazyLoadsSignalsOnDemand) {
+    writeVcd(R"(
+$timescale 1ps $end
+$scope module top $end
+$var wire 1 ! clk $end
+$var wire 8 # data [7:0] $end
+$upscope $end
+$enddefinitions $end
+#0
+0!
+b00000000 #
+#10
+1!
+#20
+0!
+b11110000 #
+)");
+
+    VcdParser eager;
+    VcdParser lazy;
+    ASSERT_TRUE(eager.parse("/tmp/test.vcd", textOnly()));
+    ParseOptions options = textOnly();
+    options.lazy = true;
+    ASSERT_TRUE(lazy.parse("/tmp/test.vcd", options));
+
+    auto& data = lazy.data();
+    ASSERT_EQ(data.signals.size(), 2);
+    EXPECT_EQ(data.signals[1].name, "top.data");
+    EXPECT_EQ(data.endTime, 20);
+    EXPECT_FALSE(data.isLoaded(0));
+    EXPECT_TRUE(data.signals[0].changes.empty());
+    // A copy shares the loader but fills in its own signals
+    WaveformData copy = data;
+
+    data.ensureLoaded(1);
+    EXPECT_TRUE(data.isLoaded(1));
+    EXPECT_FALSE(data.isLoaded(0));
+    ASSERT_EQ(data.signals[1].changes.size(), 2);
+    EXPECT_EQ(data.signals[1].changes[1].time, 20);
+    EXPECT_EQ(data.signals[1].changes[1].value, 0xF0);
+
+    data.ensureLoaded(0);
+    data.ensureLoaded(0);
+    const auto& expected = eager.data().signals[0].changes;
+    ASSERT_EQ(data.signals[0].changes.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(data.signals[0].changes[i].time, expected[i].time);
+        EXPECT_EQ(data.signals[0].changes[i].value, expected[i].value);
+    }
+
+    EXPECT_FALSE(copy.isLoaded(1));
+    EXPECT_TRUE(copy.signals[1].changes.empty());
+    copy.ensureLoaded(1);
+    EXPECT_TRUE(copy.isLoaded(1));
+    EXPECT_EQ(copy.signals[1].changes.size(), 2);
+    EXPECT_EQ(data.signals[1].changes.size(), 2);
+}
+
+TEST_F(VcdParserTest, LazyLoaderOutlivesParser) {
+    // Ids too long for the direct table go through the loader's own keys
+    writeVcd(R"(
+$timescale 1ps $end
+$scope module top $end
+$var wire 1 clk_id_long clk $end
+$var wire 8 data_id_long data [7:0] $end
+$upscope $end
+$enddefinitions $end
+#0
+0clk_id_long
+b00000001 data_id_long
+#10
+1clk_id_long
+b00000010 data_id_long
+)");
+
+    WaveformData data;
+    {
+        VcdParser parser;
+        ParseOptions options;
+        options.lazy = true;
+        ASSERT_TRUE(parser.parse("/tmp/test.vcd", options));
+        data = parser.data();
+        // Re-parsing drops the ids the parser's table was built from
+        ASSERT_TRUE(parser.parse("/tmp/test.vcd"));
+    }
+    data.ensureLoaded(1);
+    ASSERT_EQ(data.signals[1].changes.size(), 2u);
+    EXPECT_EQ(data.signals[1].changes[1].value, 2u);
+    data.ensureLoaded(0);
+    ASSERT_EQ(data.signals[0].changes.size(), 2u);
+    EXPECT_EQ(data.signals[0].changes[1].time, 10u);
+}
+
+TEST_F(VcdParserTest, ViewerLoadsOnlyVisibleRows) {
+    std::string vcd = "$timescale 1ps $end\n$scope module top $end\n";
+    for (int i = 0; i < 40; ++i) {
+        vcd += "$var wire 1 " + std::string(1, char(33 + i)) + " s" + std::to_string(i) + " $end\n";
+    }
+    vcd += "$upscope $end\n$enddefinitions $end\n#0\n";
+    for (int i = 0; i < 40; ++i) vcd += "1" + std::string(1, char(33 + i)) + "\n";
+    writeVcd(vcd.c_str());
+
+    VcdParser parser;
+    ParseOptions options;
+    options.lazy = true;
+    ASSERT_TRUE(parser.parse("/tmp/test.vcd", options));
+
+    WaveformViewer viewer;
+    viewer.setSize(800, 200);
+    viewer.setData(&parser.data());
+    auto target = Surface::MakeRecording(800, 200);
+    viewer.paint(target.get());
+
+    const auto& data = parser.data();
+    EXPECT_TRUE(data.isLoaded(0));
+    EXPECT_TRUE(data.isLoaded(4));
+    EXPECT_FALSE(data.isLoaded(5));
+    EXPECT_FALSE(data.isLoaded(39));
+    EXPECT_EQ(data.signals[4].changes.size(), 1);
+}
+
+TEST_F(VcdParserTest, BinaryCacheRoundTrip) {
+    writeVcd(R"(
+$timescale 1ns $end
+$scope module top $end
+$var wire 1 ! clk $end
+$var wire 40 # wide [39:0] $end
+$upscope $end
+$enddefinitions $end
+#0
+0!
+b0 #
+#7
+1!
+b1000000000000000000000000000000000000001 #
+#300
+0!
+)");
+
+    ParseOptions options;
+    VcdParser first;
+    ASSERT_TRUE(first.parse("/tmp/test.vcd", options));
+    std::ifstream cacheFile("/tmp/test.vcd.wvc");
+    ASSERT_TRUE(cacheFile.good());
+
+    options.lazy = true;
+    VcdParser cached;
+    ASSERT_TRUE(cached.parse("/tmp/test.vcd", options));
+    const auto& a = first.data();
+    auto& b = cached.data();
+    // A lazy open of a VCD would have no signals loaded; the cache serves them
+    ASSERT_NE(b.loader, nullptr);
+    EXPECT_EQ(a.timescale, b.timescale);
+    EXPECT_EQ(a.endTime, b.endTime);
+    ASSERT_EQ(a.signals.size(), b.signals.size());
+    for (size_t i = 0; i < a.signals.size(); ++i) {
+        b.ensureLoaded(i);
+        EXPECT_EQ(a.signals[i].name, b.signals[i].name);
+        EXPECT_EQ(a.signals[i].id, b.signals[i].id);
+        EXPECT_EQ(a.signals[i].width, b.signals[i].width);
+        ASSERT_EQ(a.signals[i].changes.size(), b.signals[i].changes.size());
+        for (size_t j = 0; j < a.signals[i].changes.size(); ++j) {
+            EXPECT_EQ(a.signals[i].changes[j].time, b.signals[i].changes[j].time);
+            EXPECT_EQ(a.signals[i].changes[j].value, b.signals[i].changes[j].value);
+        }
+    }
+    EXPECT_EQ(b.signals[1].changes[1].value, 0x8000000001ull);
+}
+
+TEST_F(VcdParserTest, BinaryCacheIgnoredWhenSourceChanges) {
+    writeVcd("$enddefinitions $end\n#5\n");
+    VcdParser first;
+    ASSERT_TRUE(first.parse("/tmp/test.vcd"));
+    EXPECT_EQ(first.data().endTime, 5);
+
+    // Rewritten in place, so the cache of the old contents is still there
+    std::ofstream("/tmp/test.vcd") << "$enddefinitions $end\n#5\n#123\n";
+    VcdParser second;
+    ASSERT_TRUE(second.parse("/tmp/test.vcd"));
+    EXPECT_EQ(second.data().endTime, 123);
+
+    ParseOptions options;
+    options.cache = false;
+    std::remove("/tmp/test.vcd.wvc");
+    VcdParser uncached;
+    ASSERT_TRUE(uncached.parse("/tmp/test.vcd", options));
+    EXPECT_FALSE(std::ifstream("/tmp/test.vcd.wvc").good());
+}
+
+TEST_F(VcdParserTest, BinaryCacheRejectsWrappingOffsets) {
+    writeVcd("$scope module top $end\n$var wire 1 ! clk $end\n$upscope $end\n"
+             "$enddefinitions $end\n#0\n0!\n#9\n1!\n");
+    VcdParser first;
+    ASSERT_TRUE(first.parse("/tmp/test.vcd"));
+
+    // Point the first name so far past the string table that the end of
+    // name and id wraps around to a small offset
+    u64 header[8];
+    {
+        std::ifstream in("/tmp/test.vcd.wvc", std::ios::binary);
+        ASSERT_TRUE(in.read(reinterpret_cast<char*>(header), sizeof(header)));
+    }
+    const u64 signalTableOffset = header[6], stringTableOffset = header[7];
+    u64 nameOffset = ~stringTableOffset + 1;
+    {
+        std::fstream out("/tmp/test.vcd.wvc", std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(std::streamoff(signalTableOffset));
+        out.write(reinterpret_cast<const char*>(&nameOffset), sizeof(nameOffset));
+    }
+
+    CacheStamp stamp;
+    ASSERT_TRUE(CacheStamp::Stat("/tmp/test.vcd", stamp));
+    WaveformData data;
+    EXPECT_FALSE(WaveformCache::Open("/tmp/test.vcd.wvc", stamp, data, false));
+    // The parser falls back to the text
+    VcdParser second;
+    ASSERT_TRUE(second.parse("/tmp/test.vcd"));
+    ASSERT_EQ(second.data().signals.size(), 1u);
+    EXPECT_EQ(second.data().signals[0].name, "top.clk");
+}
+
+TEST(DrawPassTest, BatchesWithinClipGroups) {
+    Recorder rec;
+    Color line = {80, 180, 220, 255};
+    Color text = {200, 230, 255, 255};
+    rec.setClip({0, 0, 100, 100});
+    // Text bounds reach right and down, so the labels sit right of the
+    // lines to leave them free to batch
+    for (int i = 0; i < 20; ++i) {
+        Point pts[] = {{0, f32(i)}, {10, f32(i)}, {20, f32(i)}};
+        rec.drawPolyline(pts, 3, line, 1);
+        rec.drawText({50, f32(i)}, "0x1F", text);
+    }
+    rec.clearClip();
+    rec.drawLine({0, 0}, {5, 5}, line, 1);
+    rec.drawText({0, 0}, "t", text);
+    auto recording = rec.finish();
+
+    DrawPass pass = DrawPass::create(*recording);
+    const auto& order = pass.sortedIndices();
+    ASSERT_EQ(order.size(), recording->ops().size());
+    std::vector<u32> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    for (u32 i = 0; i < sorted.size(); ++i) EXPECT_EQ(sorted[i], i);
+    // The clip group stays between its SetClip and ClearClip
+    EXPECT_EQ(recording->ops()[order.front()].type, DrawOp::Type::SetClip);
+    EXPECT_EQ(recording->ops()[order[41]].type, DrawOp::Type::ClearClip);
+
+    PassStats before = DrawPass::measure(*recording, nullptr);
+    PassStats after = DrawPass::measure(*recording, &order);
+    EXPECT_EQ(before.flushes, 23u);
+    EXPECT_EQ(after.flushes, 4u);
+    EXPECT_LT(after.stateSwitches * 2, before.stateSwitches);
+
+    auto surface = Surface::MakeRaster(100, 100);
+    surface->setCollectSubmitStats(true);
+    surface->setDrawPass(true, recording->ops().size() + 1);
+    surface->submit(*recording);
+    EXPECT_EQ(surface->submitStats().sortedRecordings, 0u);
+    EXPECT_EQ(surface->submitStats().submitted.flushes, before.flushes);
+    surface->setDrawPass(true, 0);
+    surface->submit(*recording);
+    EXPECT_EQ(surface->submitStats().recordings, 2u);
+    EXPECT_EQ(surface->submitStats().sortedRecordings, 1u);
+    EXPECT_EQ(surface->submitStats().recorded.flushes, 2 * before.flushes);
+    EXPECT_EQ(surface->submitStats().submitted.flushes, before.flushes + after.flushes);
+}
+
+TEST(DrawPassTest, SortedViewerFrameKeepsPixels) {
+    WaveformData data;
+    data.endTime = 4000;
+    for (int i = 0; i < 24; ++i) {
+        bool bus = i % 3 == 0;
+        Signal sig{"s" + std::to_string(i), "x", bus ? 8 : 1, {}};
+        for (u64 t = 0, n = 0; t < data.endTime; t += 5 + i * 7, ++n) {
+            sig.changes.push_back({t, bus ? (n * 2654435761u) & 0xFF : n & 1});
+        }
+        sig.lod.build(sig.changes);
+        data.signals.push_back(std::move(sig));
+    }
+    WaveformViewer viewer;
+    viewer.setSize(800, 600);
+    viewer.setData(&data);
+    viewer.setView(100, 0.5);
+    viewer.setCursorTime(700);
+    viewer.selectSignal(3);
+    auto recorder = Surface::MakeRecording(800, 600);
+    recorder->beginFrame();
+    viewer.paint(recorder.get());
+    recorder->endFrame();
+    auto frame = recorder->takeRecording();
+
+    GlyphCache glyphs;
+    bool font = glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f);
+    // Without a glyph cache text keeps its open-ended recorded bounds
+    for (bool text : {false, font}) {
+        auto render = [&](bool sorted) {
+            auto target = Surface::MakeRaster(800, 600);
+            if (text) target->setGlyphCache(&glyphs);
+            target->setDrawPass(sorted, 0);
+            target->setCollectSubmitStats(true);
+            target->beginFrame();
+            target->submit(*frame);
+            const u32* p = target->peekPixels()->addr32();
+            return std::make_pair(std::vector<u32>(p, p + 800 * 600), target->submitStats());
+        };
+        auto [recorded, recordedStats] = render(false);
+        auto [sorted, sortedStats] = render(true);
+        i32 mismatches = 0;
+        for (size_t i = 0; i < recorded.size(); ++i) mismatches += recorded[i] != sorted[i];
+        EXPECT_EQ(mismatches, 0) << (text ? "text" : "no text");
+        EXPECT_EQ(sortedStats.sortedRecordings, 1u);
+        EXPECT_LT(sortedStats.submitted.stateSwitches, recordedStats.submitted.stateSwitches);
+    }
+}
+
+TEST(DrawPassTest, RadixSortMatchesStableSort) {
+    std::mt19937 rng(3);
+    for (size_t count : {size_t(10), size_t(5000)}) {
+        std::vector<SortKey> keys;
+        for (u32 i = 0; i < count; ++i) {
+            // Few distinct keys, so stability decides most of the order;
+            // differing high bytes exercise more than one pass
+            keys.push_back({(u64(rng() % 3) << 48) | (u64(rng() % 2) << 8) | (rng() % 4), i});
+        }
+        std::vector<SortKey> expected = keys;
+        std::stable_sort(expected.begin(), expected.end());
+        std::vector<SortKey> tmp;
+        DrawPass::sortKeys(keys, tmp);
+        ASSERT_EQ(keys.size(), expected.size());
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(keys[i].key, expected[i].key);
+            EXPECT_EQ(keys[i].opIndex, expected[i].opIndex);
+        }
+    }
+}
+
+TEST(RecordingTest, ArenaSpansChunks) {
+    Recorder rec(nullptr);
+    std::vector<Point> big(DrawOpArena::kChunkSize / sizeof(Point) + 10);
+    for (size_t i = 0; i < big.size(); ++i) big[i] = {f32(i), 1};
+    for (int i = 0; i < 3000; ++i) rec.drawText({0, 0}, "0x" + std::to_string(i), {});
+    rec.drawPolyline(big.data(), i32(big.size()), {}, 1);
+    rec.drawText({0, 0}, "after", {});
+    auto recording = rec.finish();
+    const auto& ops = recording->ops();
+    ASSERT_EQ(ops.size(), 3002u);
+    for (int i = 0; i < 3000; ++i) {
+        EXPECT_EQ(std::string(recording->arena().getString(ops[i].data.text.offset)),
+                  "0x" + std::to_string(i));
+    }
+    const Point* pts = recording->arena().getPoints(ops[3000].data.polyline.offset);
+    EXPECT_EQ(pts[big.size() - 1].x, f32(big.size() - 1));
+    EXPECT_STREQ(recording->arena().getString(ops[3001].data.text.offset), "after");
+}
+
+TEST_F(WaveformViewerTest, SteadyPanRecordsWithoutAllocating) {
+    data.endTime = 10000;
+    for (int i = 0; i < 20; ++i) {
+        Signal sig{"s" + std::to_string(i), "x", i % 2 ? 8 : 1, {}};
+        for (u64 t = 0; t < data.endTime; t += 7 + i) sig.changes.push_back({t, (t / 7) & 0xFF});
+        sig.lod.build(sig.changes);
+        data.signals.push_back(std::move(sig));
+    }
+    viewer.setData(&data);
+    viewer.setView(0, 2.0);
+    auto target = Surface::MakeRecording(800, 600);
+    auto frame = [&](int i) {
+        viewer.setView(f64(i % 50) * 3, 2.0);
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+    };
+    // Two passes over every view: buffers left in the shared pool by earlier
+    // tests need a full cycle to grow to the largest row they are handed
+    for (int i = 0; i < 100; ++i) frame(i);
+    
+    const RecordingPool& pool = RecordingPool::shared();
+    u64 before = pool.allocations();
+    for (int i = 0; i < 20; ++i) frame(i);
+    EXPECT_EQ(pool.allocations() - before, 0u);
+    // Every frame re-recorded the rows and layers
+    EXPECT_EQ(viewer.rowsRecorded(), 17);
+}
+
+TEST_F(WaveformViewerTest, RecordingFileRoundTrips) {
+    data.signals.push_back({"bus", "#", 8, {{0, 0x12}, {40, 0x34}, {70, 0x56}}});
+    viewer.setData(&data);
+    std::vector<RecordingFrame> frames;
+    for (i32 i = 0; i < 2; ++i) {
+        viewer.setView(i * 10, 6.0);
+        auto target = Surface::MakeRecording(800, 600);
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+        frames.push_back({800, 600 - i, target->takeRecording()});
+    }
+    frames.push_back({10, 10, nullptr});
+    const char* path = "/tmp/test_frames.wvr";
+    ASSERT_TRUE(RecordingFile::Write(path, frames));
+    
+    std::vector<RecordingFrame> read;
+    ASSERT_TRUE(RecordingFile::Read(path, read));
+    ASSERT_EQ(read.size(), 3u);
+    EXPECT_EQ(read[2].recording->ops().size(), 0u);
+    for (size_t f = 0; f < 2; ++f) {
+        EXPECT_EQ(read[f].width, 800);
+        EXPECT_EQ(read[f].height, 600 - i32(f));
+        const Recording& a = *frames[f].recording;
+        const Recording& b = *read[f].recording;
+        ASSERT_EQ(a.ops().size(), b.ops().size());
+        for (size_t i = 0; i < a.ops().size(); ++i) {
+            const CompactDrawOp& x = a.ops()[i];
+            const CompactDrawOp& y = b.ops()[i];
+            ASSERT_EQ(x.type, y.type);
+            EXPECT_EQ(std::memcmp(&x.color, &y.color, sizeof(Color)), 0);
+            EXPECT_EQ(x.width, y.width);
+            if (x.type == DrawOp::Type::Text) {
+                EXPECT_EQ(std::string(a.arena().getString(x.data.text.offset), x.data.text.len),
+                          std::string(b.arena().getString(y.data.text.offset), y.data.text.len));
+            } else if (x.type == DrawOp::Type::Polyline) {
+                ASSERT_EQ(x.data.polyline.count, y.data.polyline.count);
+                EXPECT_EQ(std::memcmp(a.arena().getPoints(x.data.polyline.offset),
+                                      b.arena().getPoints(y.data.polyline.offset),
+                                      x.data.polyline.count * sizeof(Point)), 0);
+            } else if (x.type != DrawOp::Type::ClearClip) {
+                EXPECT_EQ(std::memcmp(&x.data, &y.data, sizeof(x.data)), 0);
+            }
+        }
+    }
+    
+    // Truncated and foreign files are rejected
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() - 3);
+    EXPECT_FALSE(RecordingFile::Read(path, read));
+    bytes[0] = 'X';
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+    EXPECT_FALSE(RecordingFile::Read(path, read));
+    std::remove(path);
+}
+
+TEST(RecordingTest, CullingKeepsEveryVisiblePixel) {
+    GlyphCache glyphs;
+    ASSERT_TRUE(glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f));
+    constexpr i32 kW = 200, kH = 150;
+    auto record = [](bool cull, u32 seed) {
+        std::mt19937 rng(seed);
+        auto coord = [&rng](i32 limit) { return f32(i32(rng() % u32(limit + 80)) - 40) + f32(rng() % 4) * 0.25f; };
+        Recorder rec(nullptr);
+        rec.setCulling(cull);
+        rec.setViewport({0, 0, f32(kW), f32(kH)});
+        // The row holds what lands on its own 20 px surface either way
+        Recorder row(nullptr);
+        row.setViewport({0, 0, f32(kW), 20});
+        for (int i = 0; i < 30; ++i) {
+            Point pts[] = {{coord(kW), 2}, {coord(kW), 18}, {coord(kW), coord(20)}};
+            row.drawPolyline(pts, 3, {90, 200, 90, 255}, 1);
+            row.drawText({coord(kW), coord(20)}, "0x5A", {200, 200, 255, 255});
+        }
+        auto rowRecording = row.finish();
+        for (int i = 0; i < 400; ++i) {
+            Color c = {u8(rng()), u8(rng()), u8(rng()), 255};
+            if (i % 50 == 0) rec.setClip({coord(kW), coord(kH), f32(rng() % 120), f32(rng() % 90)});
+            if (i % 50 == 40) rec.clearClip();
+            switch (rng() % 6) {
+                case 0: rec.fillRect({coord(kW), coord(kH), f32(rng() % 30), f32(rng() % 30)}, c); break;
+                case 1: rec.strokeRect({coord(kW), coord(kH), f32(rng() % 30), f32(rng() % 30)}, c, 1); break;
+                case 2: rec.drawLine({coord(kW), coord(kH)}, {coord(kW), coord(kH)}, c, 1); break;
+                case 3: {
+                    Point pts[] = {{coord(kW), coord(kH)}, {coord(kW), coord(kH)}, {coord(kW), coord(kH)}};
+                    rec.drawPolyline(pts, 3, c, 1);
+                    break;
+                }
+                case 4: rec.drawText({coord(kW), coord(kH)}, "Wg_10", c); break;
+                case 5: rec.append(*rowRecording, {coord(kW) / 4, coord(kH)}); break;
+            }
+        }
+        return rec.finish();
+    };
+    auto render = [&glyphs](const Recording& recording) {
+        auto surface = Surface::MakeRaster(kW, kH);
+        surface->setGlyphCache(&glyphs);
+        surface->beginFrame();
+        surface->submit(recording);
+        surface->endFrame();
+        const u32* px = surface->peekPixels()->addr32();
+        return std::vector<u32>(px, px + kW * kH);
+    };
+    for (u32 seed = 1; seed <= 5; ++seed) {
+        auto all = record(false, seed);
+        auto culled = record(true, seed);
+        EXPECT_EQ(all->culledOps(), 0u);
+        EXPECT_GT(culled->culledOps(), 0u);
+        EXPECT_LT(culled->ops().size(), all->ops().size());
+        EXPECT_EQ(render(*culled), render(*all)) << "seed " << seed;
+    }
+}
+
+TEST(SpanKernelsTest, MatchScalarPixelForPixel) {
+    const SpanKernels& scalar = SpanKernels::ForIsa(SpanIsa::Scalar);
+    // Odd length, so every kernel also runs its tail loop
+    constexpr i32 kCount = 256 * 3 + 5;
+    std::vector<u32> base(kCount);
+    for (i32 i = 0; i < kCount; ++i) {
+        u32 v = u32(i) & 0xFF;
+        base[i] = (u32(i * 37) << 24) | (((v * 7) & 0xFF) << 16) | ((255 - v) << 8) | v;
+    }
+    for (SpanIsa isa : {SpanIsa::Scalar, SpanIsa::SSE2, SpanIsa::AVX2}) {
+        const SpanKernels& k = SpanKernels::ForIsa(isa);
+        for (u32 alpha = 0; alpha < 256; ++alpha) {
+            u32 pixel = (alpha * 0x010101u * 13) | 0xFF000000;
+            std::vector<u32> a = base, b = base;
+            scalar.blend(a.data() + 1, kCount - 1, pixel, u8(alpha));
+            k.blend(b.data() + 1, kCount - 1, pixel, u8(alpha));
+            ASSERT_EQ(a, b) << SpanKernels::IsaName(isa) << " alpha " << alpha;
+            for (i32 i = 1; i < kCount; ++i) {
+                for (int ch = 0; ch < 24; ch += 8) {
+                    u32 s = (pixel >> ch) & 0xFF, d = (base[i] >> ch) & 0xFF;
+                    ASSERT_EQ((a[i] >> ch) & 0xFF, (s * alpha + d * (255 - alpha)) / 255);
+                }
+                ASSERT_EQ(a[i] >> 24, 0xFFu);
+            }
+        }
+        std::vector<u32> a = base, b = base;
+        scalar.fill(a.data() + 3, kCount - 3, 0x80402010);
+        k.fill(b.data() + 3, kCount - 3, 0x80402010);
+        EXPECT_EQ(a, b);
+        scalar.swizzle(a.data(), base.data(), kCount);
+        k.swizzle(b.data() + 1, base.data() + 1, kCount - 1);
+        b[0] = a[0];
+        EXPECT_EQ(a, b);
+        EXPECT_EQ(a[7], (base[7] & 0xFF00FF00) | ((base[7] >> 16) & 0xFF) | ((base[7] & 0xFF) << 16));
+    }
+}
+
+TEST(SpanKernelsTest, RasterFillsMatchAcrossIsas) {
+    auto render = [](SpanIsa isa) {
+        Pixmap pixmap = Pixmap::Alloc(PixmapInfo::MakeBGRA(97, 61));
+        SoftwareRasterDevice device(&pixmap);
+        device.setSpanKernels(SpanKernels::ForIsa(isa));
+        device.beginFrame();
+        device.fillRect({3, 2, 90, 50}, {200, 100, 50, 255});
+        device.setClipRect({10, 5, 60, 40});
+        device.fillRect({-5, -5, 200, 200}, {20, 180, 240, 77});
+        device.strokeRect({12, 8, 40, 20}, {255, 255, 255, 128}, 1);
+        device.resetClip();
+        device.fillRect({50.5f, 30.25f, 41, 9}, {0, 255, 0, 1});
+        pixmap.convert(PixelFormat::RGBA8888);
+        const u32* px = pixmap.addr32();
+        return std::vector<u32>(px, px + 97 * 61);
+    };
+    auto expected = render(SpanIsa::Scalar);
+    EXPECT_EQ(render(SpanIsa::SSE2), expected);
+    EXPECT_EQ(render(SpanIsa::AVX2), expected);
+}
+
+TEST(TiledRasterTest, MatchesSingleThreadedReplay) {
+    GlyphCache glyphs;
+    ASSERT_TRUE(glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f));
+    constexpr i32 kW = 203, kH = 151;
+    std::mt19937 rng(7);
+    auto coord = [&rng](i32 limit) { return f32(i32(rng() % u32(limit + 80)) - 40) + f32(rng() % 4) * 0.25f; };
+    auto record = [&](int ops, bool endInClip) {
+        Recorder rec(nullptr);
+        rec.setCulling(false);
+        for (int i = 0; i < ops; ++i) {
+            Color c = {u8(rng()), u8(rng()), u8(rng()), u8(i % 3 ? 255 : rng() % 256)};
+            if (i % 40 == 10) rec.setClip({coord(kW), coord(kH), f32(rng() % 150), f32(rng() % 110)});
+            if (i % 40 == 35) rec.clearClip();
+            switch (rng() % 5) {
+                case 0: rec.fillRect({coord(kW), coord(kH), f32(rng() % 90), f32(rng() % 70)}, c); break;
+                case 1: rec.strokeRect({coord(kW), coord(kH), f32(rng() % 90), f32(rng() % 70)}, c, 1); break;
+                case 2: rec.drawLine({coord(kW), coord(kH)}, {coord(kW), coord(kH)}, c, 1); break;
+                case 3: {
+                    Point pts[] = {{coord(kW), coord(kH)}, {coord(kW), coord(kH)}, {coord(kW), coord(kH)},
+                                   {coord(kW), coord(kH)}};
+                    rec.drawPolyline(pts, 4, c, 1);
+                    break;
+                }
+                case 4: rec.drawText({coord(kW), coord(kH)}, "Wg_10 q|", c); break;
+            }
+        }
+        if (endInClip) rec.setClip({30, 20, 120, 90});
+        return rec.finish();
+    };
+    // The second recording starts under the clip the first one leaves set
+    auto first = record(300, true);
+    auto second = record(300, false);
+    auto render = [&](i32 threads, i32 tileW, i32 tileH, bool drawPass) {
+        auto surface = Surface::MakeRaster(kW, kH);
+        surface->setGlyphCache(&glyphs);
+        surface->setRasterThreads(threads, tileW, tileH);
+        surface->setDrawPass(drawPass, 0);
+        surface->beginFrame();
+        surface->submit(*first);
+        surface->submit(*second);
+        surface->canvas()->fillRect({0, 0, kW, kH}, {255, 0, 0, 60});
+        surface->endFrame();
+        const u32* px = surface->peekPixels()->addr32();
+        return std::vector<u32>(px, px + kW * kH);
+    };
+    for (bool drawPass : {false, true}) {
+        auto expected = render(1, 0, 0, drawPass);
+        for (auto [tileW, tileH] : {std::pair<i32, i32>{TiledRaster::kTileWidth, TiledRaster::kTileHeight},
+                                    {64, 64}, {16, 16}, {7, 5}}) {
+            EXPECT_EQ(render(4, tileW, tileH, drawPass), expected)
+                << "tile " << tileW << "x" << tileH << (drawPass ? " sorted" : "");
+        }
+    }
+}
+
+TEST(RasterDeviceTest, AxisAlignedRunsMatchBresenham) {
+    constexpr i32 kW = 67, kH = 45;
+    // Per-pixel Bresenham with a clip test, as the device drew every line
+    // before it had run paths
+    auto reference = [](std::vector<u32>& px, const Rect* clip, i32 x1, i32 y1, i32 x2, i32 y2, Color c) {
+        auto plot = [&](i32 x, i32 y) {
+            if (x < 0 || x >= kW || y < 0 || y >= kH || c.a == 0) return;
+            if (clip && (x < i32(clip->x) || x >= i32(clip->x + clip->w) ||
+                         y < i32(clip->y) || y >= i32(clip->y + clip->h))) return;
+            u32& d = px[y * kW + x];
+            u32 out = 0xFF000000;
+            for (int ch = 0; ch < 24; ch += 8) {
+                u32 s = ch == 16 ? c.r : ch == 8 ? c.g : c.b;
+                out |= ((s * c.a + ((d >> ch) & 0xFF) * (255 - c.a)) / 255) << ch;
+            }
+            d = out;
+        };
+        i32 dx = std::abs(x2 - x1), dy = std::abs(y2 - y1);
+        i32 sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1, err = dx - dy;
+        for (;;) {
+            plot(x1, y1);
+            if (x1 == x2 && y1 == y2) break;
+            i32 e2 = 2 * err;
+            if (e2 > -dy) { err -= dy; x1 += sx; }
+            if (e2 < dx) { err += dx; y1 += sy; }
+        }
+    };
+
+    std::mt19937 rng(11);
+    auto coord = [&rng](i32 limit) { return i32(rng() % u32(limit + 20)) - 10; };
+    Pixmap pixmap = Pixmap::Alloc(PixmapInfo::MakeBGRA(kW, kH));
+    SoftwareRasterDevice device(&pixmap);
+    device.beginFrame();
+    std::vector<u32> expected(pixmap.addr32(), pixmap.addr32() + kW * kH);
+    Rect clip = {5.5f, 3.25f, 50, 30};
+    for (int i = 0; i < 600; ++i) {
+        bool clipped = i % 100 >= 50;
+        if (clipped) device.setClipRect(clip); else device.resetClip();
+        Color c = {u8(rng()), u8(rng()), u8(rng()), u8(i % 4 ? 255 : rng() % 256)};
+        i32 x1 = coord(kW), y1 = coord(kH);
+        i32 x2 = i % 3 == 0 ? x1 : coord(kW), y2 = i % 3 == 1 ? y1 : coord(kH);
+        if (i % 5 == 4) {
+            // Polylines draw the shared vertex once per segment
+            Point pts[] = {{f32(x1), f32(y1)}, {f32(x2), f32(y1)}, {f32(x2), f32(y2)}, {f32(x1), f32(y2)}};
+            device.drawPolyline(pts, 4, c, 1);
+            reference(expected, clipped ? &clip : nullptr, x1, y1, x2, y1, c);
+            reference(expected, clipped ? &clip : nullptr, x2, y1, x2, y2, c);
+            reference(expected, clipped ? &clip : nullptr, x2, y2, x1, y2, c);
+        } else {
+            device.drawLine({f32(x1), f32(y1)}, {f32(x2), f32(y2)}, c, 1);
+            reference(expected, clipped ? &clip : nullptr, x1, y1, x2, y2, c);
+        }
+        ASSERT_EQ(std::vector<u32>(pixmap.addr32(), pixmap.addr32() + kW * kH), expected)
+            << "line " << i << " (" << x1 << "," << y1 << ")-(" << x2 << "," << y2 << ")";
+    }
+}
+
+TEST_F(WaveformViewerTest, CursorMoveDamagesOnlyTheOverlay) {
+    Signal bus{"bus", "\"", 8, {}};
+    for (u64 t = 0; t < 100; t += 9) bus.changes.push_back({t, t * 7 & 0xFF});
+    data.signals.push_back(std::move(bus));
+    data.signals.push_back({"rst", "#", 1, {{0, 1}, {35, 0}}});
+    viewer.setData(&data);
+    viewer.setScrollReuse(true);
+
+    GlyphCache glyphs;
+    ASSERT_TRUE(glyphs.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f));
+    auto retained = Surface::MakeRaster(800, 600);
+    retained->setGlyphCache(&glyphs);
+    retained->setRetainContents(true);
+    auto fresh = Surface::MakeRaster(800, 600);
+    fresh->setGlyphCache(&glyphs);
+    WaveformViewer reference;
+    reference.setSize(800, 600);
+    reference.setData(&data);
+
+    auto area = [&]() {
+        u64 pixels = 0;
+        for (const Rect& r : viewer.damage()) pixels += u64(r.w) * u64(r.h);
+        return pixels;
+    };
+    for (f64 cursor : {10.0, 12.5, 40.0, 40.0, 93.0, 3.0}) {
+        viewer.setCursorTime(cursor);
+        reference.setCursorTime(cursor);
+        retained->beginFrame();
+        viewer.paint(retained.get());
+        fresh->beginFrame();
+        reference.paint(fresh.get());
+        const u32* a = retained->peekPixels()->addr32();
+        const u32* b = fresh->peekPixels()->addr32();
+        ASSERT_EQ(std::vector<u32>(a, a + 800 * 600), std::vector<u32>(b, b + 800 * 600))
+            << "cursor " << cursor;
+        if (cursor == 10.0) EXPECT_EQ(area(), 800u * 600u);
+        else EXPECT_LT(area(), 800u * 600u / 20) << "cursor " << cursor;
+    }
+
+    // A repaint with nothing changed touches nothing; a view change
+    // redraws everything
+    retained->beginFrame();
+    viewer.paint(retained.get());
+    EXPECT_EQ(area(), 0u);
+    viewer.setView(5, 6.0);
+    retained->beginFrame();
+    viewer.paint(retained.get());
+    EXPECT_EQ(area(), 800u * 600u);
+}
+
+TEST_F(WaveformViewerTest, ResizeMatchesFreshViewer) {
+    Signal bus{"bus", "\"", 8, {}};
+    for (u64 t = 0; t < 100; t += 9) bus.changes.push_back({t, t * 7 & 0xFF});
+    data.signals.push_back(std::move(bus));
+
+    auto render = [](WaveformViewer& v, i32 w, i32 h) {
+        auto target = Surface::MakeRaster(w, h);
+        target->beginFrame();
+        v.paint(target.get());
+        const u32* p = target->peekPixels()->addr32();
+        return std::vector<u32>(p, p + size_t(w) * h);
+    };
+    WaveformViewer fresh;
+    fresh.setSize(800, 600);
+    fresh.setData(&data);
+    fresh.setView(0, 7.0);
+    std::vector<u32> expected = render(fresh, 800, 600);
+
+    for (bool async : {false, true}) {
+        WaveformViewer v;
+        v.setData(&data);
+        // Settings changed while async rebuilds are on reach the builder
+        v.setAsync(async);
+        v.setRecordThreads(2);
+        v.setFrameBudget(10000);
+        v.setSize(400, 200);
+        v.setView(0, 7.0);
+        render(v, 400, 200);
+        v.setSize(800, 600);
+        v.setView(0, 7.0);
+        std::vector<u32> got = render(v, 800, 600);
+        i32 mismatches = 0;
+        for (size_t i = 0; i < got.size(); ++i) mismatches += got[i] != expected[i];
+        EXPECT_EQ(mismatches, 0) << "async " << async;
+    }
+}
+
+namespace {
+
+// Holds every load, and the async rebuild making it, while closed
+class GatedLoader : public SignalLoader {
+public:
+    void setOpen(bool open) {
+        {
+            std::lock_guard<std::mutex> lock(gateMutex_);
+            open_ = open;
+        }
+        opened_.notify_all();
+    }
+
+protected:
+    void loadSignals(WaveformData&, const size_t*, size_t) override {
+        std::unique_lock<std::mutex> lock(gateMutex_);
+        opened_.wait(lock, [this]() { return open_; });
+    }
+
+private:
+    std::mutex gateMutex_;
+    std::condition_variable opened_;
+    bool open_ = true;
+};
+
+}
+
+TEST_F(WaveformViewerTest, AsyncPanPreviewStaysOutOfNameColumn) {
+    for (int i = 0; i < 30; ++i) {
+        Signal bus{"b" + std::to_string(i), "x", 8, {}};
+        for (u64 t = 0; t < 2000; t += 3) bus.changes.push_back({t, t * 7 + u64(i)});
+        data.signals.push_back(std::move(bus));
+    }
+    data.endTime = 2000;
+    auto loader = std::make_shared<GatedLoader>();
+    data.loader = loader;
+    viewer.setAsync(true);
+    viewer.setFrameBudget(10000);
+    viewer.setView(0, 8.0);
+    auto target = Surface::MakeRaster(800, 600);
+    auto paint = [&]() {
+        target->beginFrame();
+        viewer.paint(target.get());
+        target->endFrame();
+    };
+    auto names = [&target]() {
+        std::vector<u32> column;
+        const u32* p = target->peekPixels()->addr32();
+        for (i32 y = 0; y < 600; ++y) column.insert(column.end(), p + y * 800, p + y * 800 + 120);
+        return column;
+    };
+    paint();
+    ASSERT_FALSE(viewer.rebuildPending());
+    std::vector<u32> expected = names();
+
+    // The next rebuild reloads the rows and waits at the closed loader, so
+    // the frame shows the preview: panning forward shifts it left
+    loader->setOpen(false);
+    data.loadedSignals.clear();
+    viewer.setFrameBudget(0);
+    viewer.setView(40, 8.0);
+    paint();
+    EXPECT_TRUE(viewer.rebuildPending());
+    std::vector<u32> got = names();
+    i32 mismatches = 0;
+    for (size_t p = 0; p < got.size(); ++p) mismatches += got[p] != expected[p];
+    EXPECT_EQ(mismatches, 0);
+
+    loader->setOpen(true);
+    viewer.setFrameBudget(10000);
+    paint();
+    EXPECT_FALSE(viewer.rebuildPending());
+}
@@ -0,0 +1,179 @@
+// Replays captured frames (see RecordingFile) and reports frame times.
+//
+// Usage: wv_replay [--gpu] [--runs N] [--sort] file.wvr
+// Every frame of the file is submitted N times (default 20) to a raster
+// surface, or with --gpu to an offscreen OpenGL context, and the per-frame
+// times are reported as percentiles. --sort enables DrawPass ordering.
+// Capture files with waveform_example --capture file.wvr.
+
+#include "recording_file.hpp"
+#include "surface.hpp"
+#include "glyph_cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if WAVEFORM_HAS_GL
+#include "context.hpp"
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+#endif
+
+using namespace wv;
+
+struct ReplayStats {
+    std::vector<double> frameUs;
+    u64 ops = 0;
+};
+
+// Submits every frame runs times; sync is called after each frame so that
+// the time covers the work the backend queued
+template <typename Sync>
+static ReplayStats replay(Surface& surface, const std::vector<RecordingFrame>& frames, int runs,
+                          Sync sync) {
+    ReplayStats stats;
+    stats.frameUs.reserve(frames.size() * size_t(runs));
+    i32 w = 0, h = 0;
+    for (int r = 0; r < runs; ++r) {
+        for (const RecordingFrame& frame : frames) {
+            if (frame.width != w || frame.height != h) {
+                w = frame.width;
+                h = frame.height;
+                surface.resize(w, h);
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            surface.beginFrame();
+            surface.submit(*frame.recording);
+            surface.endFrame();
+            surface.flush();
+            sync();
+            auto t1 = std::chrono::steady_clock::now();
+            stats.frameUs.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            stats.ops += frame.recording->ops().size();
+        }
+    }
+    return stats;
+}
+
+static void report(const char* backend, ReplayStats& stats) {
+    std::vector<double>& t = stats.frameUs;
+    if (t.empty()) return;
+    std::sort(t.begin(), t.end());
+    auto pct = [&t](double p) { return t[std::min(t.size() - 1, size_t(p * double(t.size())))]; };
+    double sum = 0;
+    for (double v : t) sum += v;
+    std::printf("%s: %zu frames, %.0f ops/frame\n", backend, t.size(), double(stats.ops) / double(t.size()));
+    std::printf("  mean %9.1f us  p50 %9.1f us  p90 %9.1f us  p99 %9.1f us  max %9.1f us\n",
+                sum / double(t.size()), pct(0.50), pct(0.90), pct(0.99), t.back());
+}
+
+#if WAVEFORM_HAS_GL
+static int replayGl(const std::vector<RecordingFrame>& frames, int runs, bool sort,
+                    GlyphCache& glyphCache) {
+    Display* dpy = XOpenDisplay(nullptr);
+    if (!dpy) {
+        std::fprintf(stderr, "cannot open X display\n");
+        return 1;
+    }
+    i32 maxW = 1, maxH = 1;
+    for (const RecordingFrame& frame : frames) {
+        maxW = std::max(maxW, frame.width);
+        maxH = std::max(maxH, frame.height);
+    }
+
+    // Offscreen: a pbuffer large enough for every frame
+    int fbAttribs[] = {GLX_DRAWABLE_TYPE, GLX_PBUFFER_BIT, GLX_RENDER_TYPE, GLX_RGBA_BIT,
+                       GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None};
+    int configCount = 0;
+    GLXFBConfig* configs = glXChooseFBConfig(dpy, DefaultScreen(dpy), fbAttribs, &configCount);
+    if (!configs || configCount == 0) {
+        std::fprintf(stderr, "no pbuffer config\n");
+        XCloseDisplay(dpy);
+        return 1;
+    }
+    int pbAttribs[] = {GLX_PBUFFER_WIDTH, maxW, GLX_PBUFFER_HEIGHT, maxH, None};
+    GLXPbuffer pbuffer = glXCreatePbuffer(dpy, configs[0], pbAttribs);
+    GLXContext glxCtx = glXCreateNewContext(dpy, configs[0], GLX_RGBA_TYPE, nullptr, True);
+    XFree(configs);
+    if (!glxCtx) {
+        glXDestroyPbuffer(dpy, pbuffer);
+        XCloseDisplay(dpy);
+        return 1;
+    }
+    glXMakeContextCurrent(dpy, pbuffer, pbuffer, glxCtx);
+
+    int result = 1;
+    if (auto surface = Surface::MakeGpu(Context::MakeGL(), frames[0].width, frames[0].height)) {
+        surface->setGlyphCache(&glyphCache);
+        surface->setDrawPass(sort, 0);
+        ReplayStats stats = replay(*surface, frames, runs, []() { glFinish(); });
+        report("gl", stats);
+        result = 0;
+    }
+
+    glXMakeContextCurrent(dpy, None, None, nullptr);
+    glXDestroyContext(dpy, glxCtx);
+    glXDestroyPbuffer(dpy, pbuffer);
+    XCloseDisplay(dpy);
+    return result;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    bool useGpu = false;
+    bool sort = false;
+    int runs = 20;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--gpu") == 0) {
+            useGpu = true;
+        } else if (std::strcmp(argv[i], "--sort") == 0) {
+            sort = true;
+        } else if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        std::fprintf(stderr, "usage: wv_replay [--gpu] [--runs N] [--sort] file.wvr\n");
+        return 1;
+    }
+
+    std::vector<RecordingFrame> frames;
+    if (!RecordingFile::Read(path, frames)) {
+        std::fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    if (frames.empty()) {
+        std::fprintf(stderr, "%s has no frames\n", path);
+        return 1;
+    }
+
+    GlyphCache glyphCache;
+    if (!glyphCache.init("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 13.0f)) {
+        if (!glyphCache.init("/usr/share/fonts/TTF/DejaVuSansMono.ttf", 13.0f)) {
+            std::fprintf(stderr, "Failed to load font\n");
+        }
+    }
+
+    int result = 0;
+    if (useGpu) {
+#if WAVEFORM_HAS_GL
+        result = replayGl(frames, runs, sort, glyphCache);
+#else
+        std::fprintf(stderr, "GPU backend not available\n");
+        result = 1;
+#endif
+    } else {
+        auto surface = Surface::MakeRaster(frames[0].width, frames[0].height);
+        surface->setGlyphCache(&glyphCache);
+        surface->setDrawPass(sort, 0);
+        ReplayStats stats = replay(*surface, frames, runs, []() {});
+        report("raster", stats);
+    }
+    glyphCache.release();
+    return result;
+}